@@ -0,0 +1,339 @@
+#ifndef ARENA_STL_H
+#define ARENA_STL_H
+
+namespace internal
+{
+	// The default alignment of the blocks obtained from the memory resources
+	const std::size_t max_align = alignof(std::max_align_t);
+
+	class memory_resource
+	{
+	public:
+		virtual ~memory_resource() { }
+
+	public:
+		void* allocate(std::size_t bytes, std::size_t alignment = internal::max_align) {
+			return this->do_allocate(bytes, alignment);
+		}
+
+		void deallocate(void* p, std::size_t bytes, std::size_t alignment = internal::max_align) {
+			this->do_deallocate(p, bytes, alignment);
+		}
+
+	protected:
+		virtual void* do_allocate(std::size_t bytes, std::size_t alignment) = 0;
+		virtual void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) = 0;
+	};
+
+	class new_delete_resource : public memory_resource
+	{
+	protected:
+		void* do_allocate(std::size_t bytes, std::size_t alignment)
+		{
+			if (alignment <= internal::max_align)
+				return ::operator new(bytes);
+
+			// Over-allocate the block and keep the pointer to its origin ahead of the aligned address
+			char* origin = static_cast<char*>(::operator new(bytes + alignment + sizeof(void*)));
+			std::uintptr_t address = reinterpret_cast<std::uintptr_t>(origin + sizeof(void*));
+			char* aligned = reinterpret_cast<char*>((address + alignment - 1) & ~(alignment - 1));
+			reinterpret_cast<void**>(aligned)[-1] = origin;
+			return aligned;
+		}
+
+		void do_deallocate(void* p, std::size_t, std::size_t alignment)
+		{
+			if (alignment <= internal::max_align)
+				::operator delete(p);
+			else ::operator delete(reinterpret_cast<void**>(p)[-1]);
+		}
+	};
+
+	inline memory_resource* default_resource()
+	{
+		static new_delete_resource resource;
+		return &resource;
+	}
+
+	class scratch_arena : public memory_resource
+	{
+	public:
+		explicit scratch_arena(memory_resource* upstream = internal::default_resource())
+			: _upstream(upstream), allocations(0) { }
+
+		~scratch_arena() { this->release(); }
+
+		scratch_arena(const scratch_arena&) = delete;
+		scratch_arena& operator=(const scratch_arena&) = delete;
+
+	public:
+		// Make the whole memory of the arena available again without returning
+		// it upstream. If the arena has grown into several blocks, replace them
+		// with a single block large enough to serve the same requests next time
+		void reset()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (blocks.size() > 1)
+			{
+				std::size_t capacity = 0L;
+				for (const block& b : blocks) capacity += b.size;
+				this->release_blocks(); this->grow(capacity);
+			}
+
+			for (block& b : blocks) b.used = 0;
+		}
+
+		// Return the whole memory of the arena to the upstream resource
+		void release()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			this->release_blocks();
+		}
+
+		// The number of blocks that the arena has obtained from the upstream resource
+		std::size_t upstream_allocations() const { return allocations; }
+
+	protected:
+		void* do_allocate(std::size_t bytes, std::size_t alignment)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			// Bump the pointer within the last block or obtain a new block from upstream
+			if (blocks.empty() || !this->fits(blocks.back(), bytes, alignment))
+				this->grow(std::max(bytes + alignment, \
+					blocks.empty() ? std::size_t(65536) : blocks.back().size * 2));
+
+			block& b = blocks.back();
+			std::uintptr_t address = reinterpret_cast<std::uintptr_t>(b.data) + b.used;
+			std::uintptr_t aligned = (address + alignment - 1) & ~(alignment - 1);
+			b.used = (aligned - reinterpret_cast<std::uintptr_t>(b.data)) + bytes;
+
+			return reinterpret_cast<void*>(aligned);
+		}
+
+		// The memory is reclaimed only by reset or release of the entire arena
+		void do_deallocate(void*, std::size_t, std::size_t) { }
+
+	protected:
+		struct block
+		{
+			char* data;
+			std::size_t size, used;
+		};
+
+		bool fits(const block& b, std::size_t bytes, std::size_t alignment) const {
+			return b.used + bytes + alignment <= b.size;
+		}
+
+		void grow(std::size_t size)
+		{
+			block b = { static_cast<char*>(_upstream->allocate(size, internal::max_align)), size, 0 };
+			blocks.push_back(b); allocations++;
+		}
+
+		void release_blocks()
+		{
+			for (const block& b : blocks)
+				_upstream->deallocate(b.data, b.size, internal::max_align);
+			blocks.clear();
+		}
+
+	protected:
+		memory_resource* _upstream;
+		std::vector<block> blocks;
+		std::size_t allocations;
+		std::mutex lock;
+	};
+
+	// The size and the alignment of a huge page of the processor
+	const std::size_t huge_page_size = 2097152;
+
+	enum class huge_page_mode
+	{
+		// The small pages only, so that the huge pages can be compared against them
+		none,
+		// The transparent huge pages requested for the mapping by madvise
+		transparent,
+		// The huge pages reserved by the system (hugetlbfs or the large pages on Windows)
+		hugetlbfs
+	};
+
+	inline huge_page_mode huge_page_config()
+	{
+		// Obtain the mode from the environment: "none", "transparent" (the default) or "hugetlbfs"
+		const char* mode = std::getenv("PARALLEL_SORT_HUGE_PAGES");
+		if (mode == NULL) return huge_page_mode::transparent;
+		if (std::strcmp(mode, "none") == 0 || std::strcmp(mode, "off") == 0)
+			return huge_page_mode::none;
+		return (std::strcmp(mode, "hugetlbfs") == 0) ? \
+			huge_page_mode::hugetlbfs : huge_page_mode::transparent;
+	}
+
+	class huge_page_resource : public memory_resource
+	{
+	public:
+		explicit huge_page_resource(huge_page_mode mode = internal::huge_page_config(), \
+			memory_resource* upstream = internal::default_resource())
+			: _mode(mode), _upstream(upstream), huge(0), small(0) { }
+
+		huge_page_resource(const huge_page_resource&) = delete;
+		huge_page_resource& operator=(const huge_page_resource&) = delete;
+
+	public:
+		huge_page_mode mode() const { return _mode; }
+
+		// The number of the large blocks backed by the huge pages and by the small pages
+		std::size_t huge_allocations() const { return huge.load(); }
+		std::size_t small_allocations() const { return small.load(); }
+
+	protected:
+		void* do_allocate(std::size_t bytes, std::size_t alignment)
+		{
+			// The blocks smaller than a huge page are obtained from upstream
+			if (bytes < internal::huge_page_size)
+				return _upstream->allocate(bytes, alignment);
+
+			std::size_t size = this->rounded(bytes);
+			void* p = NULL;
+
+		#if defined( _WIN32 )
+			// The large pages are granted to the processes holding the lock-pages privilege
+			std::size_t large = ::GetLargePageMinimum();
+			if (_mode != huge_page_mode::none && large > 0 && size % large == 0)
+				p = ::VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+			if (p != NULL) { huge++; return p; }
+
+			// Otherwise, reserve the space larger by a huge page and allocate the block at
+			// the aligned address within it, once the space has been released again
+			for (int attempt = 0; attempt < 4 && p == NULL; attempt++)
+			{
+				char* space = static_cast<char*>(::VirtualAlloc(NULL, size + internal::huge_page_size, \
+					MEM_RESERVE, PAGE_NOACCESS));
+				if (space == NULL) break;
+
+				std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(space) + \
+					internal::huge_page_size - 1) & ~(internal::huge_page_size - 1);
+				::VirtualFree(space, 0, MEM_RELEASE);
+				p = ::VirtualAlloc(reinterpret_cast<void*>(aligned), size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+			}
+
+			// Give up the alignment rather than the allocation if another thread
+			// has taken the aligned address each time
+			if (p == NULL) p = ::VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+			if (p == NULL) throw std::bad_alloc();
+			small++;
+		#else
+			// Map the block from the pool of the reserved huge pages if it has been configured
+			if (_mode == huge_page_mode::hugetlbfs)
+			{
+				p = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+				if (p != MAP_FAILED) { huge++; return p; }
+			}
+
+			// Otherwise, map the space larger by a huge page and unmap its parts
+			// ahead of and behind the aligned block
+			char* space = static_cast<char*>(::mmap(NULL, size + internal::huge_page_size, \
+				PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+			if (space == MAP_FAILED) throw std::bad_alloc();
+
+			std::uintptr_t address = reinterpret_cast<std::uintptr_t>(space);
+			std::uintptr_t aligned = (address + internal::huge_page_size - 1) & ~(internal::huge_page_size - 1);
+			if (aligned > address) ::munmap(space, aligned - address);
+			if (aligned - address < internal::huge_page_size)
+				::munmap(reinterpret_cast<char*>(aligned) + size, internal::huge_page_size - (aligned - address));
+			p = reinterpret_cast<void*>(aligned);
+
+			// Ask the kernel to back the block by the transparent huge pages, or to keep the
+			// small pages. The block falls back to the small pages if these are unavailable
+			bool is_huge = _mode != huge_page_mode::none && ::madvise(p, size, MADV_HUGEPAGE) == 0;
+			if (_mode == huge_page_mode::none) ::madvise(p, size, MADV_NOHUGEPAGE);
+			if (is_huge) huge++; else small++;
+		#endif
+
+			return p;
+		}
+
+		void do_deallocate(void* p, std::size_t bytes, std::size_t alignment)
+		{
+			if (bytes < internal::huge_page_size) {
+				_upstream->deallocate(p, bytes, alignment); return;
+			}
+
+		#if defined( _WIN32 )
+			::VirtualFree(p, 0, MEM_RELEASE);
+		#else
+			::munmap(p, this->rounded(bytes));
+		#endif
+		}
+
+		std::size_t rounded(std::size_t bytes) const
+		{
+			// Round the size of the block up to the whole huge pages
+			return (bytes + internal::huge_page_size - 1) & ~(internal::huge_page_size - 1);
+		}
+
+	protected:
+		huge_page_mode _mode;
+		memory_resource* _upstream;
+		std::atomic<std::size_t> huge, small;
+	};
+
+	inline memory_resource* huge_page_memory()
+	{
+		// The resource of the large scratch buffers and the generated arrays,
+		// configured once from the environment
+		static huge_page_resource resource;
+		return &resource;
+	}
+
+	template<class T>
+	struct arena_allocator
+	{
+	public:
+		typedef T value_type;
+
+		arena_allocator(memory_resource* resource = internal::default_resource())
+			: _resource(resource) { }
+
+		template<class U>
+		arena_allocator(const arena_allocator<U>& other) : _resource(other.resource()) { }
+
+	public:
+		T* allocate(std::size_t count) {
+			return static_cast<T*>(_resource->allocate(count * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T* p, std::size_t count) {
+			_resource->deallocate(p, count * sizeof(T), alignof(T));
+		}
+
+		memory_resource* resource() const { return _resource; }
+
+	protected:
+		memory_resource* _resource;
+	};
+
+	template<class T>
+	struct huge_page_allocator : public arena_allocator<T>
+	{
+	public:
+		// The allocator drawing the memory from the huge pages unless given another resource
+		huge_page_allocator(memory_resource* resource = internal::huge_page_memory())
+			: arena_allocator<T>(resource) { }
+
+		template<class U>
+		huge_page_allocator(const huge_page_allocator<U>& other) : arena_allocator<T>(other.resource()) { }
+	};
+
+	template<class T, class U>
+	bool operator==(const arena_allocator<T>& a, const arena_allocator<U>& b) {
+		return a.resource() == b.resource();
+	}
+
+	template<class T, class U>
+	bool operator!=(const arena_allocator<T>& a, const arena_allocator<U>& b) {
+		return a.resource() != b.resource();
+	}
+}
+
+#endif // ARENA_STL_H
@@ -0,0 +1,96 @@
+#include "parallel_sort.h"
+
+#ifndef ASYNC_SORT_STL_H
+#define ASYNC_SORT_STL_H
+
+namespace internal
+{
+	struct async_state
+	{
+		// The progress and cancellation state shared with the sorter
+		sort_control control;
+		// The highest progress reported to the caller so far
+		std::atomic<std::size_t> reported;
+	};
+
+	class sort_handle
+	{
+	public:
+		sort_handle(std::shared_ptr<async_state> state, std::shared_future<bool> result)
+			: _state(state), _result(result) { }
+
+	public:
+		// Obtain the fraction of data items that have reached their final partitions
+		double progress() const
+		{
+			std::size_t total = _state->control.total;
+			if (total == 0) return 1.0;
+
+			// Never report less progress than has already been reported,
+			// since the final pass of the sort restarts the accounting
+			std::size_t finalized = std::min(total, _state->control.finalized.load());
+			std::size_t reported = _state->reported.load();
+			while (finalized > reported && \
+				!_state->reported.compare_exchange_weak(reported, finalized));
+
+			return std::max(finalized, reported) / (double)total;
+		}
+
+		// Request the cooperative cancellation checked at the partition boundaries
+		void cancel() { _state->control.cancelled = true; }
+
+		bool done() const {
+			return _result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		}
+
+		// Wait for the sort to finish and obtain true if it has completed
+		// or false if it has been cancelled and the array is left unsorted
+		bool get() const { return _result.get(); }
+		void wait() const { _result.wait(); }
+
+		std::shared_future<bool> future() const { return _result; }
+
+	protected:
+		std::shared_ptr<async_state> _state;
+		std::shared_future<bool> _result;
+	};
+
+	template<class RanIt, class _Pred>
+	sort_handle sort_async(RanIt _First, RanIt _Last, _Pred compare, \
+		std::function<void(bool)> callback = std::function<void(bool)>(), \
+		thread_pool& pool = thread_pool::shared())
+	{
+		std::shared_ptr<async_state> state = std::make_shared<async_state>();
+		state->control.total = std::distance(_First, _Last);
+
+		std::shared_ptr<std::promise<bool>> promise = std::make_shared<std::promise<bool>>();
+		std::shared_future<bool> result = promise->get_future().share();
+
+		// Run the sort on a host thread of the pool, which only hosts the master of the team,
+		// the workers are drawn from the pool just as for the synchronous calls. The pool
+		// runs the sort to the end before it is destroyed, but the array must outlive it
+		pool.submit([state, promise, callback, &pool, _First, _Last, compare]()
+		{
+			try
+			{
+				sort_stats stats;
+				internal::parallel_sort(_First, _Last, compare, stats, pool, &state->control);
+
+				// Invoke the completion callback prior to making the result ready. The sort
+				// has completed unless it has skipped some work, even if the cancellation
+				// has been requested after the array had already been sorted
+				bool completed = !state->control.abandoned;
+				if (callback) callback(completed);
+				promise->set_value(completed);
+			}
+
+			catch (...) {
+				promise->set_exception(std::current_exception());
+			}
+		});
+
+		return sort_handle(state, result);
+	}
+}
+
+#endif // ASYNC_SORT_STL_H
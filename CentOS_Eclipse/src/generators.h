@@ -1,39 +1,96 @@
+#include "arena.h"
+
 #ifndef GENERATORS_STL_H
 #define GENERATORS_STL_H
 
 namespace gen
 {
-	template<class Container = std::vector<std::int64_t>>
-	void generate_lots_of_duplicates(Container& a, std::size_t size)
+	// The default seed of the random values generator
+	const std::uint64_t default_seed = 0x2545F4914F6CDD1DULL;
+
+	struct counter_rng
 	{
-		std::random_device rd; std::mt19937 gen(rd());
-		std::uniform_int_distribution<> dist(1, 100);
+	public:
+		explicit counter_rng(std::uint64_t seed = gen::default_seed, std::uint64_t stream = 0)
+			: key(mix(seed ^ mix(stream + 0x6A09E667F3BCC909ULL))) { }
 
-		#pragma omp parallel for
+	public:
+		// Obtain the random value located at the specific counter position
+		// of the stream. The value depends only on the seed, the stream and
+		// the counter, so that the sequence doesn't depend on the thread count
+		std::uint64_t operator()(std::uint64_t counter) const {
+			return mix(key + counter * 0x9E3779B97F4A7C15ULL);
+		}
+
+		// Obtain the value uniformly distributed within the range [lo, hi]
+		std::int64_t uniform(std::uint64_t counter, std::int64_t lo, std::int64_t hi) const {
+			std::uint64_t range = static_cast<std::uint64_t>(hi - lo) + 1;
+			return (range == 0) ? static_cast<std::int64_t>((*this)(counter)) :
+				lo + static_cast<std::int64_t>(mulhi((*this)(counter), range));
+		}
+
+		// Obtain the value uniformly distributed within the range [0, 1)
+		double canonical(std::uint64_t counter) const {
+			return ((*this)(counter) >> 11) * (1.0 / 9007199254740992.0);
+		}
+
+	public:
+		// SplitMix64 finalizer used as the counter-based mixing function
+		static std::uint64_t mix(std::uint64_t z) {
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			return z ^ (z >> 31);
+		}
+
+		// Compute the high 64 bits of the 128-bit product of two values
+		static std::uint64_t mulhi(std::uint64_t a, std::uint64_t b) {
+			std::uint64_t a_lo = a & 0xFFFFFFFFULL, a_hi = a >> 32;
+			std::uint64_t b_lo = b & 0xFFFFFFFFULL, b_hi = b >> 32;
+			std::uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo;
+			std::uint64_t lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+			std::uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFULL) + lo_hi;
+			return hi_hi + (hi_lo >> 32) + (cross >> 32);
+		}
+
+	protected:
+		std::uint64_t key;
+	};
+
+	template<class Container, class _Func>
+	void fill(Container& a, std::size_t size, _Func func)
+	{
+		// Each thread fills its own contiguous block of counters,
+		// and the loop body is vectorized within each block
+		#pragma omp parallel for simd schedule(static)
 		for (std::size_t index = 0; index < size; index++)
-			a[index] = dist(gen);
+			a[index] = func(index);
 	}
 
 	template<class Container = std::vector<std::int64_t>>
-	void generate_binary_sequence(Container& a, std::size_t size)
+	void generate_lots_of_duplicates(Container& a, std::size_t size, \
+		std::uint64_t seed = gen::default_seed)
 	{
-		std::random_device rd; std::mt19937 gen(rd());
-		std::uniform_int_distribution<> dist(0, 1);
-
-		#pragma omp parallel for
-		for (std::size_t index = 0; index < size; index++)
-			a[index] = dist(gen);
+		const counter_rng rng(seed, 1);
+		gen::fill(a, size, [&rng](std::size_t index) {
+			return rng.uniform(index, 1, 100); });
 	}
 
 	template<class Container = std::vector<std::int64_t>>
-	void generate_random_sequence(Container& a, std::size_t size)
+	void generate_binary_sequence(Container& a, std::size_t size, \
+		std::uint64_t seed = gen::default_seed)
 	{
-		std::random_device rd; std::mt19937 gen(rd());
-		std::uniform_int_distribution<> dist(1, size);
+		const counter_rng rng(seed, 2);
+		gen::fill(a, size, [&rng](std::size_t index) {
+			return static_cast<std::int64_t>(rng(index) >> 63); });
+	}
 
-		#pragma omp parallel for
-		for (std::size_t index = 0; index < size; index++)
-			a[index] = dist(gen);
+	template<class Container = std::vector<std::int64_t>>
+	void generate_random_sequence(Container& a, std::size_t size, \
+		std::uint64_t seed = gen::default_seed)
+	{
+		const counter_rng rng(seed, 3);
+		gen::fill(a, size, [&rng, size](std::size_t index) {
+			return rng.uniform(index, 1, size); });
 	}
 
 	template<class Container = std::vector<std::int64_t>>
@@ -55,10 +112,8 @@ namespace gen
 	template<class Container = std::vector<std::int64_t>>
 	void generate_interleave_sequence(Container& a, std::size_t size)
 	{
-		std::size_t n = 0;
-		for (std::size_t index = 0; index < size / 5; index++)
-			for (std::size_t nindex = 0; nindex < 5; nindex++)
-				a[n++] = nindex;
+		gen::fill(a, size - size % 5, [](std::size_t index) {
+			return static_cast<std::int64_t>(index % 5); });
 	}
 
 	template<class Container = std::vector<std::int64_t>>
@@ -68,6 +123,190 @@ namespace gen
 		for (std::size_t index = 0; index < size; index++)
 			a[index] = 1;
 	}
+
+	template<class Container = std::vector<std::int64_t>>
+	void generate_zipfian_sequence(Container& a, std::size_t size, \
+		std::uint64_t seed = gen::default_seed, double skew = 1.0)
+	{
+		const counter_rng rng(seed, 4);
+		// Sample the ranks 1..N by inverting the CDF of the continuous
+		// counterpart of Zipf's law, so that no table of weights is needed
+		const double n = static_cast<double>(size) + 1.0;
+		const double exponent = 1.0 - skew;
+		const double span = (std::fabs(exponent) < 1e-9) ? \
+			std::log(n) : std::pow(n, exponent) - 1.0;
+
+		gen::fill(a, size, [&rng, exponent, span](std::size_t index) {
+			double u = rng.canonical(index);
+			double x = (std::fabs(exponent) < 1e-9) ? std::exp(u * span) : \
+				std::pow(1.0 + u * span, 1.0 / exponent);
+			return static_cast<std::int64_t>(x); });
+	}
+
+	template<class Container = std::vector<std::int64_t>>
+	void generate_exponential_sequence(Container& a, std::size_t size, \
+		std::uint64_t seed = gen::default_seed)
+	{
+		const counter_rng rng(seed, 5);
+		const double mean = std::max(1.0, size / 16.0);
+		gen::fill(a, size, [&rng, mean](std::size_t index) {
+			return static_cast<std::int64_t>(-std::log(1.0 - rng.canonical(index)) * mean); });
+	}
+
+	template<class Container = std::vector<std::int64_t>>
+	void generate_perturbed_sequence(Container& a, std::size_t size, \
+		std::uint64_t seed = gen::default_seed, std::size_t percent = 1)
+	{
+		const counter_rng rng(seed, 6);
+		// Replace about the given percent of items of the sorted sequence with random values
+		const double fraction = percent / 100.0;
+		gen::fill(a, size, [&rng, size, fraction](std::size_t index) {
+			return (rng.canonical(2 * index) < fraction) ? \
+				rng.uniform(2 * index + 1, 0, size - 1) : static_cast<std::int64_t>(index); });
+	}
+
+	template<class Container = std::vector<std::int64_t>>
+	void generate_sorted_tail_sequence(Container& a, std::size_t size, \
+		std::uint64_t seed = gen::default_seed, std::size_t percent = 10)
+	{
+		const counter_rng rng(seed, 7);
+		// Keep the head of the sequence sorted and fill the tail with random values
+		const std::size_t head = size - size * percent / 100;
+		gen::fill(a, size, [&rng, size, head](std::size_t index) {
+			return (index < head) ? static_cast<std::int64_t>(index) : \
+				rng.uniform(index, 0, size - 1); });
+	}
+
+	template<class Container = std::vector<std::int64_t>>
+	void generate_organ_pipe_sequence(Container& a, std::size_t size)
+	{
+		gen::fill(a, size, [size](std::size_t index) {
+			return static_cast<std::int64_t>( \
+				(index < size / 2) ? index : size - index - 1); });
+	}
+
+	template<class Container = std::vector<std::int64_t>>
+	void generate_sawtooth_sequence(Container& a, std::size_t size)
+	{
+		const std::size_t period = std::max(std::size_t(2), \
+			static_cast<std::size_t>(std::sqrt((double)size)));
+		gen::fill(a, size, [period](std::size_t index) {
+			return static_cast<std::int64_t>(index % period); });
+	}
+
+	template<class Container = std::vector<std::int64_t>>
+	void generate_staggered_sequence(Container& a, std::size_t size)
+	{
+		// Interleave 32 ascending runs with each other: the run r holds the values
+		// r, r + 32, r + 64, ..., so that all values are distinct regardless of the size
+		const std::size_t stride = 32;
+		const std::size_t length = (size + stride - 1) / stride;
+		gen::fill(a, size, [stride, length](std::size_t index) {
+			return static_cast<std::int64_t>((index % length) * stride + index / length); });
+	}
+
+	template<class Container = std::vector<std::int64_t>>
+	void generate_few_unique_large(Container& a, std::size_t size, \
+		std::uint64_t seed = gen::default_seed, std::size_t unique = 16)
+	{
+		const counter_rng rng(seed, 8), values(seed, 9);
+		gen::fill(a, size, [&rng, &values, unique](std::size_t index) {
+			return static_cast<std::int64_t>( \
+				values(rng.uniform(index, 0, unique - 1)) >> 1); });
+	}
+
+	template<class Container = std::vector<std::int64_t>>
+	void generate_gaussian_sequence(Container& a, std::size_t size, \
+		std::uint64_t seed = gen::default_seed)
+	{
+		const counter_rng rng(seed, 10);
+		const double mean = size / 2.0, sigma = std::max(1.0, size / 8.0);
+		// Use the Box-Muller transform of two uniform values per item
+		gen::fill(a, size, [&rng, mean, sigma](std::size_t index) {
+			double u1 = 1.0 - rng.canonical(2 * index);
+			double u2 = rng.canonical(2 * index + 1);
+			return static_cast<std::int64_t>(std::floor(mean + sigma * \
+				std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2))); });
+	}
+
+	template<class Container = std::vector<std::int64_t>>
+	void generate_low_entropy_high_bits(Container& a, std::size_t size, \
+		std::uint64_t seed = gen::default_seed)
+	{
+		const counter_rng rng(seed, 11);
+		// The high 32 bits take one of 4 values, the low 32 bits are random
+		gen::fill(a, size, [&rng](std::size_t index) {
+			std::uint64_t r = rng(index);
+			return static_cast<std::int64_t>( \
+				((0x40000000ULL + (r >> 62)) << 32) | (r & 0xFFFFFFFFULL)); });
+	}
+
+	// The generated arrays are backed by the huge pages to reduce the misses of the TLB
+	typedef std::vector<std::int64_t, internal::huge_page_allocator<std::int64_t>> sequence;
+
+	struct distribution
+	{
+		// The name used to select the distribution in benchmarks and stress tests
+		const char* name;
+		// The human-readable description of the distribution
+		const char* title;
+		// The generator that fills the array with the given size and seed
+		void(*generate)(sequence& a, std::size_t size, std::uint64_t seed);
+	};
+
+	inline const std::vector<distribution>& distributions()
+	{
+		static const std::vector<distribution> catalog = {
+			{ "random", "randomized sequence", [](sequence& a, std::size_t size, \
+				std::uint64_t seed) { gen::generate_random_sequence(a, size, seed); } },
+			{ "duplicates", "lots of duplicates", [](sequence& a, std::size_t size, \
+				std::uint64_t seed) { gen::generate_lots_of_duplicates(a, size, seed); } },
+			{ "binary", "binary sequence", [](sequence& a, std::size_t size, \
+				std::uint64_t seed) { gen::generate_binary_sequence(a, size, seed); } },
+			{ "ascending", "ascending sequence", [](sequence& a, std::size_t size, \
+				std::uint64_t) { gen::generate_ascending_sequence(a, size); } },
+			{ "descending", "descending sequence", [](sequence& a, std::size_t size, \
+				std::uint64_t) { gen::generate_descending_sequence(a, size); } },
+			{ "interleave", "interleave sequence", [](sequence& a, std::size_t size, \
+				std::uint64_t) { gen::generate_interleave_sequence(a, size); } },
+			{ "single_value", "single value sequence", [](sequence& a, std::size_t size, \
+				std::uint64_t) { gen::generate_single_value(a, size); } },
+			{ "zipfian", "zipfian sequence", [](sequence& a, std::size_t size, \
+				std::uint64_t seed) { gen::generate_zipfian_sequence(a, size, seed); } },
+			{ "exponential", "exponential sequence", [](sequence& a, std::size_t size, \
+				std::uint64_t seed) { gen::generate_exponential_sequence(a, size, seed); } },
+			{ "perturbed", "sorted with 1% perturbations", [](sequence& a, std::size_t size, \
+				std::uint64_t seed) { gen::generate_perturbed_sequence(a, size, seed); } },
+			{ "sorted_tail", "sorted with unsorted tail", [](sequence& a, std::size_t size, \
+				std::uint64_t seed) { gen::generate_sorted_tail_sequence(a, size, seed); } },
+			{ "organ_pipe", "organ-pipe sequence", [](sequence& a, std::size_t size, \
+				std::uint64_t) { gen::generate_organ_pipe_sequence(a, size); } },
+			{ "sawtooth", "sawtooth sequence", [](sequence& a, std::size_t size, \
+				std::uint64_t) { gen::generate_sawtooth_sequence(a, size); } },
+			{ "staggered", "staggered sequence", [](sequence& a, std::size_t size, \
+				std::uint64_t) { gen::generate_staggered_sequence(a, size); } },
+			{ "few_unique_large", "few unique large values", [](sequence& a, std::size_t size, \
+				std::uint64_t seed) { gen::generate_few_unique_large(a, size, seed); } },
+			{ "gaussian", "gaussian sequence", [](sequence& a, std::size_t size, \
+				std::uint64_t seed) { gen::generate_gaussian_sequence(a, size, seed); } },
+			{ "low_entropy_high_bits", "64-bit keys with low-entropy high bits", \
+				[](sequence& a, std::size_t size, std::uint64_t seed) { \
+					gen::generate_low_entropy_high_bits(a, size, seed); } },
+		};
+
+		return catalog;
+	}
+
+	inline int find_distribution(const std::string& name)
+	{
+		// Find the index of the distribution with the given name
+		const std::vector<distribution>& catalog = gen::distributions();
+		for (std::size_t index = 0; index < catalog.size(); index++)
+			if (name == catalog[index].name)
+				return static_cast<int>(index);
+
+		return -1;
+	}
 }
 
 #endif // GENERATORS_STL_H
@@ -0,0 +1,249 @@
+#include "co_sort.h"
+#include "generators.h"
+
+#ifndef GENSORT_STL_H
+#define GENSORT_STL_H
+
+namespace internal
+{
+	// The sizes (in bytes) of the record of the sort benchmark and of its key
+	const std::size_t record_size = 100;
+	const std::size_t record_key_size = 10;
+	// The number of low bits of the cached key holding the position of the record
+	const int record_index_bits = 48;
+
+	struct gensort_record
+	{
+		// The 10-byte key compared as the unsigned bytes, and the 90-byte payload
+		unsigned char key[internal::record_key_size];
+		unsigned char payload[internal::record_size - internal::record_key_size];
+	};
+
+	static_assert(sizeof(gensort_record) == internal::record_size, "the record must be 100 bytes");
+
+	// The array of records backed by the huge pages, as the generated arrays of keys
+	typedef std::vector<gensort_record, huge_page_allocator<gensort_record>> record_array;
+
+	inline bool operator<(const gensort_record& first, const gensort_record& second) {
+		return std::memcmp(first.key, second.key, internal::record_key_size) < 0;
+	}
+
+	struct record_prefix
+	{
+		// The first 8 bytes of the key as the big-endian value, and the last 2 bytes
+		// of the key followed by the position of the record it has been taken from
+		std::uint64_t head, tail;
+	};
+
+	struct prefix_less
+	{
+		// Compare the cached keys without reading the records. The keys are
+		// never equal, since the positions break the ties of the equal keys
+		bool operator()(const record_prefix& first, const record_prefix& second) const {
+			return first.head < second.head || (first.head == second.head && first.tail < second.tail);
+		}
+	};
+
+	inline record_prefix key_prefix(const gensort_record& record, std::size_t index)
+	{
+		record_prefix prefix = { 0, static_cast<std::uint64_t>(index) };
+		for (std::size_t byte = 0; byte < 8; byte++)
+			prefix.head = (prefix.head << 8) | record.key[byte];
+		prefix.tail |= (static_cast<std::uint64_t>(record.key[8]) << 56) | \
+			(static_cast<std::uint64_t>(record.key[9]) << internal::record_index_bits);
+		return prefix;
+	}
+
+	inline std::size_t prefix_index(const record_prefix& prefix) {
+		return static_cast<std::size_t>(prefix.tail & ((std::uint64_t(1) << internal::record_index_bits) - 1));
+	}
+
+	inline std::uint32_t crc32(const unsigned char* data, std::size_t size)
+	{
+		// Compute the CRC-32 (the polynomial of zlib) by the table of the byte remainders
+		static const std::vector<std::uint32_t> table = [] {
+			std::vector<std::uint32_t> remainders(256);
+			for (std::uint32_t byte = 0; byte < 256; byte++)
+			{
+				std::uint32_t value = byte;
+				for (int bit = 0; bit < 8; bit++)
+					value = (value & 1) ? (value >> 1) ^ 0xEDB88320U : (value >> 1);
+				remainders[byte] = value;
+			}
+			return remainders;
+		}();
+
+		std::uint32_t crc = 0xFFFFFFFFU;
+		for (std::size_t index = 0; index < size; index++)
+			crc = table[(crc ^ data[index]) & 0xFF] ^ (crc >> 8);
+		return crc ^ 0xFFFFFFFFU;
+	}
+
+	inline void generate_record(gensort_record& record, std::uint64_t number, const gen::counter_rng& rng)
+	{
+		// Lay the record out as the binary record of gensort: the random key, the bytes
+		// 0x00 0x11, the record number as 32 hex digits, the bytes 0x88 0x99 0xAA 0xBB,
+		// 48 bytes of the filler and the bytes 0xCC 0xDD 0xEE 0xFF
+		static const char digits[] = "0123456789ABCDEF";
+		std::uint64_t high = rng(2 * number), low = rng(2 * number + 1);
+		for (std::size_t byte = 0; byte < 8; byte++)
+			record.key[byte] = static_cast<unsigned char>(high >> (56 - 8 * byte));
+		record.key[8] = static_cast<unsigned char>(low >> 56);
+		record.key[9] = static_cast<unsigned char>(low >> 48);
+
+		unsigned char* payload = record.payload;
+		payload[0] = 0x00; payload[1] = 0x11;
+		for (std::size_t digit = 0; digit < 32; digit++)
+			payload[2 + digit] = (digit < 16) ? '0' : digits[(number >> (4 * (31 - digit))) & 0xF];
+		payload[34] = 0x88; payload[35] = 0x99; payload[36] = 0xAA; payload[37] = 0xBB;
+
+		// Repeat each of the 12 nibbles of the low 48 random bits 4 times
+		for (std::size_t group = 0; group < 12; group++)
+			std::memset(payload + 38 + 4 * group, digits[(low >> (4 * (11 - group))) & 0xF], 4);
+		payload[86] = 0xCC; payload[87] = 0xDD; payload[88] = 0xEE; payload[89] = 0xFF;
+	}
+
+	template<class RanIt>
+	void generate_records(RanIt _First, RanIt _Last, std::uint64_t first_number = 0, \
+		std::uint64_t seed = gen::default_seed)
+	{
+		// Generate each record from its number, so that the records don't depend
+		// on the thread count and a file can be generated by the ranges of records
+		gen::counter_rng rng(seed);
+		std::int64_t _Size = std::distance(_First, _Last);
+		#pragma omp parallel for schedule(static)
+		for (std::int64_t index = 0; index < _Size; index++)
+			internal::generate_record(_First[index], first_number + index, rng);
+	}
+
+	struct record_summary
+	{
+		// The number of records and the number of those whose key is less than
+		// the key of their predecessor, and the position of the first of them
+		std::size_t records, unordered, first_unordered;
+		// The number of records whose key equals the key of their predecessor
+		std::size_t duplicates;
+		// The 128-bit sum of the CRC-32 of all records, which doesn't depend on their order
+		std::uint64_t checksum_high, checksum_low;
+
+		bool is_sorted() const { return unordered == 0; }
+
+		void add(std::uint64_t crc) {
+			checksum_low += crc; checksum_high += (checksum_low < crc);
+		}
+
+		void merge(const record_summary& other)
+		{
+			records += other.records; unordered += other.unordered;
+			first_unordered = std::min(first_unordered, other.first_unordered);
+			duplicates += other.duplicates;
+			checksum_high += other.checksum_high; this->add(other.checksum_low);
+		}
+	};
+
+	template<class RanIt>
+	record_summary validate_records(RanIt _First, RanIt _Last, thread_pool& pool = thread_pool::shared())
+	{
+		// Summarize the records as valsort does: check their order, count the
+		// duplicate keys and sum up the checksums of the records
+		pool_lease lease(pool, omp_get_max_threads());
+		std::size_t _Size = std::distance(_First, _Last);
+		const record_summary empty = { 0L, 0L, _Size, 0L, 0, 0 };
+		std::vector<record_summary> parts(lease.size(), empty);
+
+		#pragma omp parallel num_threads(lease.size()) shared(parts)
+		{
+			int tid = omp_get_thread_num(), team = omp_get_num_threads();
+			std::size_t begin = _Size * tid / team, end = _Size * (tid + 1) / team;
+			record_summary& part = parts[tid];
+			part.records = end - begin;
+
+			// Compare each record with its predecessor, including the last record of the previous share
+			for (std::size_t index = begin; index < end; index++)
+			{
+				const gensort_record& record = _First[index];
+				part.add(internal::crc32(reinterpret_cast<const unsigned char*>(&record), sizeof(record)));
+				if (index == 0) continue;
+
+				int order = std::memcmp(_First[index - 1].key, record.key, internal::record_key_size);
+				if (order > 0 && part.unordered++ == 0) part.first_unordered = index;
+				part.duplicates += (order == 0);
+			}
+		}
+
+		record_summary summary = empty;
+		for (const record_summary& part : parts)
+			summary.merge(part);
+		return summary;
+	}
+
+	template<class RanIt, class OutIt>
+	void sort_records(RanIt _First, RanIt _Last, OutIt _Dest, sort_stats& stats, \
+		thread_pool& pool = thread_pool::shared())
+	{
+		// Sort the records into the destination by their cached keys, so that the sort
+		// moves the 16-byte keys and each 100-byte record is moved exactly once
+		std::int64_t _Size = std::distance(_First, _Last);
+		std::vector<record_prefix> keys(_Size);
+		{
+			// Release the workers before the sort draws them from the same pool
+			pool_lease lease(pool, omp_get_max_threads());
+			#pragma omp parallel for num_threads(lease.size()) schedule(static)
+			for (std::int64_t index = 0; index < _Size; index++)
+				keys[index] = internal::key_prefix(_First[index], index);
+		}
+
+		internal::parallel_sort(keys.begin(), keys.end(), internal::prefix_less(), stats, pool);
+
+		// Gather the records in the order of their keys, prefetching the source records
+		// ahead, since these are read in the random order
+		pool_lease lease(pool, omp_get_max_threads());
+		#pragma omp parallel for num_threads(lease.size()) schedule(static)
+		for (std::int64_t index = 0; index < _Size; index++)
+		{
+			if (index + static_cast<std::int64_t>(internal::prefetch_distance) < _Size)
+				internal::prefetch(&*(_First + internal::prefix_index(keys[index + internal::prefetch_distance])));
+			*(_Dest + index) = *(_First + internal::prefix_index(keys[index]));
+		}
+	}
+
+	template<class RanIt>
+	void sort_records(RanIt _First, RanIt _Last, sort_stats& stats, thread_pool& pool = thread_pool::shared())
+	{
+		// Sort the records into the buffer and copy them back into place
+		std::int64_t _Size = std::distance(_First, _Last);
+		record_array buffer(_Size);
+		internal::sort_records(_First, _Last, buffer.begin(), stats, pool);
+
+		pool_lease lease(pool, omp_get_max_threads());
+		#pragma omp parallel for num_threads(lease.size()) schedule(static)
+		for (std::int64_t index = 0; index < _Size; index++)
+			_First[index] = buffer[index];
+	}
+
+	inline bool read_records(const std::string& filename, record_array& records)
+	{
+		// Read the whole file of the records, which must consist of the whole records only
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) return false;
+
+		std::streamoff size = file.tellg();
+		if (size < 0 || size % internal::record_size != 0) return false;
+
+		records.resize(static_cast<std::size_t>(size / internal::record_size));
+		file.seekg(0, std::ios::beg);
+		return records.empty() || file.read(reinterpret_cast<char*>(records.data()), size).good();
+	}
+
+	inline bool write_records(const std::string& filename, const record_array& records)
+	{
+		std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) return false;
+
+		file.write(reinterpret_cast<const char*>(records.data()), \
+			static_cast<std::streamsize>(records.size() * internal::record_size));
+		return file.good();
+	}
+}
+
+#endif // GENSORT_STL_H
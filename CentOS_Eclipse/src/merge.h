@@ -0,0 +1,332 @@
+#include "parallel_sort.h"
+
+#ifndef MERGE_STL_H
+#define MERGE_STL_H
+
+namespace internal
+{
+	template<class RanIt1, class RanIt2, class _Pred>
+	std::size_t co_rank(std::size_t diag, RanIt1 _First1, std::size_t size1, \
+		RanIt2 _First2, std::size_t size2, _Pred compare)
+	{
+		// Find the number of items taken from the first array among the first diag
+		// items of the merged output (the merge path), items of the first array
+		// being placed ahead of the equal items of the second one
+		std::size_t lo = (diag > size2) ? diag - size2 : 0;
+		std::size_t hi = std::min(diag, size1);
+
+		while (lo < hi)
+		{
+			std::size_t i = lo + (hi - lo) / 2, j = diag - i;
+			// Take more items from the first array while its next item
+			// is not greater than the last item taken from the second array
+			if (j > 0 && i < size1 && !compare(*(_First2 + (j - 1)), *(_First1 + i)))
+				lo = i + 1;
+			else hi = i;
+		}
+
+		return lo;
+	}
+
+	template<class RanIt1, class RanIt2, class OutIt, class _Pred>
+	void parallel_merge(RanIt1 _First1, RanIt1 _Last1, RanIt2 _First2, RanIt2 _Last2, \
+		OutIt _Dest, _Pred compare, sort_context& ctx)
+	{
+		std::size_t size1 = std::distance(_First1, _Last1);
+		std::size_t size2 = std::distance(_First2, _Last2);
+		std::size_t size = size1 + size2;
+
+		// Perform a sequential merge if the arrays are too small to be split
+		if (ctx.threads <= 1 || size <= ctx.tuning.spawn * 8)
+		{
+			internal::perf_scope scope(ctx.perf, sort_phase::merge);
+			std::merge(_First1, _Last1, _First2, _Last2, _Dest, compare);
+			return;
+		}
+
+		// Split the merge path into equal parts, so that each thread gets
+		// an equal share of the output regardless of the distribution of data
+		const std::int64_t parts = ctx.threads * 4;
+		std::vector<std::size_t> ranks(parts + 1);
+
+		#pragma omp parallel num_threads(ctx.threads) shared(ranks)
+		{
+			// Find all split points before any part is merged, since the parts
+			// merged through the move iterators leave their items moved-from
+			#pragma omp for schedule(static)
+			for (std::int64_t part = 0; part <= parts; part++)
+				ranks[part] = internal::co_rank(size * part / parts, _First1, size1, _First2, size2, compare);
+
+			#pragma omp for schedule(dynamic, 1)
+			for (std::int64_t part = 0; part < parts; part++)
+			{
+				// Attribute the counters of each worker to the merge phase
+				internal::perf_scope scope(ctx.perf, sort_phase::merge);
+				internal::trace_scope trace(ctx.tracer, "merge", sort_phase::merge, size / parts, 0);
+
+				std::size_t diag1 = size * part / parts, diag2 = size * (part + 1) / parts;
+				std::size_t i1 = ranks[part], i2 = ranks[part + 1];
+				std::merge(_First1 + i1, _First1 + i2, _First2 + (diag1 - i1), \
+					_First2 + (diag2 - i2), _Dest + diag1, compare);
+			}
+		}
+	}
+
+	template<class RanIt1, class RanIt2, class OutIt, class _Pred>
+	void parallel_merge(RanIt1 _First1, RanIt1 _Last1, RanIt2 _First2, RanIt2 _Last2, \
+		OutIt _Dest, _Pred compare, thread_pool& pool = thread_pool::shared())
+	{
+		pool_lease lease(pool, omp_get_max_threads());
+		sort_context ctx = { lease.size(), sort_stats(), NULL, NULL, \
+			sort_engine::three_way, internal::tuning_for(_First1), 0L, 0L, NULL, NULL, NULL };
+		internal::parallel_merge(_First1, _Last1, _First2, _Last2, _Dest, compare, ctx);
+	}
+
+	template<class OutIt>
+	struct is_random_output : std::is_base_of<std::random_access_iterator_tag, \
+		typename std::iterator_traits<OutIt>::iterator_category> { };
+
+	template<class RanIt1, class RanIt2, class OutIt, class _Pred>
+	OutIt merge_into(RanIt1 _First1, RanIt1 _Last1, RanIt2 _First2, RanIt2 _Last2, \
+		OutIt _Dest, _Pred compare, thread_pool& pool, std::true_type)
+	{
+		internal::parallel_merge(_First1, _Last1, _First2, _Last2, _Dest, compare, pool);
+		return _Dest + (std::distance(_First1, _Last1) + std::distance(_First2, _Last2));
+	}
+
+	template<class RanIt1, class RanIt2, class OutIt, class _Pred>
+	OutIt merge_into(RanIt1 _First1, RanIt1 _Last1, RanIt2 _First2, RanIt2 _Last2, \
+		OutIt _Dest, _Pred compare, thread_pool&, std::false_type)
+	{
+		// The parts can't be written at their offsets through an output iterator
+		// that is not random-access (e.g. std::back_inserter), so merge sequentially
+		return std::merge(_First1, _Last1, _First2, _Last2, _Dest, compare);
+	}
+
+	template<class RanIt, class _Pred>
+	void parallel_inplace_merge(RanIt _First, RanIt _Middle, RanIt _Last, \
+		_Pred compare, thread_pool& pool = thread_pool::shared(), memory_resource* scratch = NULL)
+	{
+		typedef typename std::iterator_traits<RanIt>::value_type T;
+
+		if (_First == _Middle || _Middle == _Last) return;
+
+		pool_lease lease(pool, omp_get_max_threads());
+		sort_context ctx = { lease.size(), sort_stats(), NULL, scratch, \
+			sort_engine::three_way, internal::tuning_for(_First), 0L, 0L, NULL, NULL, NULL };
+
+		// Merge both runs into the scratch buffer and move the result back into place
+		std::int64_t _Size = std::distance(_First, _Last);
+		std::vector<T, arena_allocator<T>> buffer(_Size, arena_allocator<T>(internal::scratch(ctx)));
+		internal::parallel_merge(std::make_move_iterator(_First), std::make_move_iterator(_Middle), \
+			std::make_move_iterator(_Middle), std::make_move_iterator(_Last), buffer.begin(), compare, ctx);
+
+		#pragma omp parallel for num_threads(ctx.threads) schedule(static)
+		for (std::int64_t index = 0; index < _Size; index++)
+			_First[index] = std::move(buffer[index]);
+	}
+
+	class count_iterator
+	{
+	public:
+		// The output iterator that only counts the items written through it
+		typedef std::output_iterator_tag iterator_category;
+		typedef void value_type;
+		typedef void difference_type;
+		typedef void pointer;
+		typedef void reference;
+
+		explicit count_iterator(std::size_t& count) : _count(&count) { }
+
+	public:
+		template<class T>
+		count_iterator& operator=(const T&) { ++*_count; return *this; }
+
+		count_iterator& operator*() { return *this; }
+		count_iterator& operator++() { return *this; }
+		count_iterator& operator++(int) { return *this; }
+
+	protected:
+		std::size_t* _count;
+	};
+
+	template<class T>
+	class construct_iterator
+	{
+	public:
+		// The output iterator that move-constructs the items written through it
+		// in the uninitialized storage, advanced by the offsets as the merge does
+		typedef std::output_iterator_tag iterator_category;
+		typedef void value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef void pointer;
+		typedef void reference;
+
+		explicit construct_iterator(T* storage) : _storage(storage) { }
+
+	public:
+		construct_iterator& operator=(T&& value) { ::new (static_cast<void*>(_storage)) T(std::move(value)); return *this; }
+		construct_iterator& operator=(const T& value) { ::new (static_cast<void*>(_storage)) T(value); return *this; }
+
+		construct_iterator& operator*() { return *this; }
+		construct_iterator& operator++() { ++_storage; return *this; }
+		construct_iterator operator++(int) { construct_iterator it(*this); ++_storage; return it; }
+		construct_iterator operator+(difference_type offset) const { return construct_iterator(_storage + offset); }
+
+	protected:
+		T* _storage;
+	};
+
+	template<class RanIt1, class RanIt2, class _Pred>
+	std::pair<std::size_t, std::size_t> key_split(std::size_t diag, RanIt1 _First1, std::size_t size1, \
+		RanIt2 _First2, std::size_t size2, _Pred compare)
+	{
+		// Find the item at the position diag of the merged output
+		if (diag >= size1 + size2) return std::make_pair(size1, size2);
+
+		std::size_t i = internal::co_rank(diag, _First1, size1, _First2, size2, compare), j = diag - i;
+		bool is_first = i < size1 && (j >= size2 || !compare(*(_First2 + j), *(_First1 + i)));
+		const auto& key = is_first ? *(_First1 + i) : *(_First2 + j);
+
+		// Find the runs of the items equal to it in both arrays
+		std::pair<RanIt1, RanIt1> run1 = std::equal_range(_First1, _First1 + size1, key, compare);
+		std::pair<RanIt2, RanIt2> run2 = std::equal_range(_First2, _First2 + size2, key, compare);
+		std::size_t a0 = std::distance(_First1, run1.first), m = std::distance(run1.first, run1.second);
+		std::size_t b0 = std::distance(_First2, run2.first), n = std::distance(run2.first, run2.second);
+
+		// Split both runs after the same number of pairs of the equal items, the k-th
+		// equal item of the first array paired with the k-th of the second one. Each
+		// part then outputs the equal items of its pairs as the whole operation does,
+		// so that the split keeps the multiplicity of the standard set operations,
+		// while the number of pairs keeps the part at its share of the merge path
+		std::size_t taken = diag - a0 - b0, common = std::min(m, n);
+		std::size_t pairs = (taken <= 2 * common) ? (taken + 1) / 2 : taken - common;
+		return std::make_pair(a0 + std::min(pairs, m), b0 + std::min(pairs, n));
+	}
+
+	template<class RanIt1, class RanIt2, class OutIt, class _Pred, class _SetOp>
+	OutIt parallel_set_operation(RanIt1 _First1, RanIt1 _Last1, RanIt2 _First2, RanIt2 _Last2, \
+		OutIt _Dest, _Pred compare, _SetOp operation, sort_context& ctx)
+	{
+		std::size_t size1 = std::distance(_First1, _Last1);
+		std::size_t size2 = std::distance(_First2, _Last2);
+		std::size_t size = size1 + size2;
+
+		// Perform the sequential operation if the arrays are too small to be split
+		if (ctx.threads <= 1 || size <= ctx.tuning.spawn * 8)
+		{
+			internal::perf_scope scope(ctx.perf, sort_phase::merge);
+			return operation(_First1, _Last1, _First2, _Last2, _Dest, compare);
+		}
+
+		// Split the merge path into equal parts, regardless of the runs of equal items.
+		// Since the size of the output is unknown upfront, each part counts its output
+		// first, and writes it at the offset given by the prefix sum of the counts
+		const std::int64_t parts = ctx.threads * 4;
+		std::vector<std::pair<std::size_t, std::size_t>> splits(parts + 1);
+		std::vector<std::size_t> offsets(parts + 1, 0);
+
+		#pragma omp parallel num_threads(ctx.threads) shared(splits, offsets)
+		{
+			#pragma omp for schedule(static)
+			for (std::int64_t part = 0; part <= parts; part++)
+				splits[part] = internal::key_split(size * part / parts, \
+					_First1, size1, _First2, size2, compare);
+
+			#pragma omp for schedule(dynamic, 1)
+			for (std::int64_t part = 0; part < parts; part++)
+			{
+				internal::perf_scope scope(ctx.perf, sort_phase::merge);
+				operation(_First1 + splits[part].first, _First1 + splits[part + 1].first, \
+					_First2 + splits[part].second, _First2 + splits[part + 1].second, \
+					count_iterator(offsets[part + 1]), compare);
+			}
+
+			#pragma omp single
+			for (std::int64_t part = 0; part < parts; part++)
+				offsets[part + 1] += offsets[part];
+
+			#pragma omp for schedule(dynamic, 1)
+			for (std::int64_t part = 0; part < parts; part++)
+			{
+				internal::perf_scope scope(ctx.perf, sort_phase::merge);
+				internal::trace_scope trace(ctx.tracer, "set", sort_phase::merge, \
+					offsets[part + 1] - offsets[part], 0);
+				operation(_First1 + splits[part].first, _First1 + splits[part + 1].first, \
+					_First2 + splits[part].second, _First2 + splits[part + 1].second, \
+					_Dest + offsets[part], compare);
+			}
+		}
+
+		return _Dest + offsets[parts];
+	}
+
+	struct set_union_op
+	{
+		template<class InIt1, class InIt2, class OutIt, class _Pred>
+		OutIt operator()(InIt1 _First1, InIt1 _Last1, InIt2 _First2, InIt2 _Last2, OutIt _Dest, _Pred compare) const {
+			return std::set_union(_First1, _Last1, _First2, _Last2, _Dest, compare);
+		}
+	};
+
+	struct set_intersection_op
+	{
+		template<class InIt1, class InIt2, class OutIt, class _Pred>
+		OutIt operator()(InIt1 _First1, InIt1 _Last1, InIt2 _First2, InIt2 _Last2, OutIt _Dest, _Pred compare) const {
+			return std::set_intersection(_First1, _Last1, _First2, _Last2, _Dest, compare);
+		}
+	};
+
+	struct set_difference_op
+	{
+		template<class InIt1, class InIt2, class OutIt, class _Pred>
+		OutIt operator()(InIt1 _First1, InIt1 _Last1, InIt2 _First2, InIt2 _Last2, OutIt _Dest, _Pred compare) const {
+			return std::set_difference(_First1, _Last1, _First2, _Last2, _Dest, compare);
+		}
+	};
+
+	template<class RanIt1, class RanIt2, class OutIt, class _Pred, class _SetOp>
+	OutIt parallel_set_operation(RanIt1 _First1, RanIt1 _Last1, RanIt2 _First2, RanIt2 _Last2, \
+		OutIt _Dest, _Pred compare, _SetOp operation, thread_pool&, std::false_type)
+	{
+		// The parts can't be written at their offsets through an output iterator
+		// that is not random-access, so perform the sequential operation
+		return operation(_First1, _Last1, _First2, _Last2, _Dest, compare);
+	}
+
+	template<class RanIt1, class RanIt2, class OutIt, class _Pred, class _SetOp>
+	OutIt parallel_set_operation(RanIt1 _First1, RanIt1 _Last1, RanIt2 _First2, RanIt2 _Last2, \
+		OutIt _Dest, _Pred compare, _SetOp operation, thread_pool& pool, std::true_type)
+	{
+		pool_lease lease(pool, omp_get_max_threads());
+		sort_context ctx = { lease.size(), sort_stats(), NULL, NULL, \
+			sort_engine::three_way, internal::tuning_for(_First1), 0L, 0L, NULL, NULL, NULL };
+		return internal::parallel_set_operation(_First1, _Last1, _First2, _Last2, _Dest, compare, operation, ctx);
+	}
+
+	template<class RanIt1, class RanIt2, class OutIt, class _Pred>
+	OutIt parallel_set_union(RanIt1 _First1, RanIt1 _Last1, RanIt2 _First2, RanIt2 _Last2, \
+		OutIt _Dest, _Pred compare, thread_pool& pool = thread_pool::shared())
+	{
+		return internal::parallel_set_operation(_First1, _Last1, _First2, _Last2, \
+			_Dest, compare, set_union_op(), pool, is_random_output<OutIt>());
+	}
+
+	template<class RanIt1, class RanIt2, class OutIt, class _Pred>
+	OutIt parallel_set_intersection(RanIt1 _First1, RanIt1 _Last1, RanIt2 _First2, RanIt2 _Last2, \
+		OutIt _Dest, _Pred compare, thread_pool& pool = thread_pool::shared())
+	{
+		return internal::parallel_set_operation(_First1, _Last1, _First2, _Last2, \
+			_Dest, compare, set_intersection_op(), pool, is_random_output<OutIt>());
+	}
+
+	template<class RanIt1, class RanIt2, class OutIt, class _Pred>
+	OutIt parallel_set_difference(RanIt1 _First1, RanIt1 _Last1, RanIt2 _First2, RanIt2 _Last2, \
+		OutIt _Dest, _Pred compare, thread_pool& pool = thread_pool::shared())
+	{
+		return internal::parallel_set_operation(_First1, _Last1, _First2, _Last2, \
+			_Dest, compare, set_difference_op(), pool, is_random_output<OutIt>());
+	}
+}
+
+#endif // MERGE_STL_H
@@ -1,16 +1,178 @@
+#include "arena.h"
+#include "tuning.h"
+#include "perf_counters.h"
+#include "tracer.h"
+#include "key_groups.h"
+#include "counting_sort.h"
 #include "utility.h"
+#include "thread_pool.h"
 
 #ifndef PARALLEL_SORT_STL_H
 #define PARALLEL_SORT_STL_H
 
 namespace internal
 {
-	std::size_t g_depth = 0L;
+	struct sort_stats
+	{
+		// The number of calls to the recursive sorting routines
+		std::size_t depth;
+		// The number of threads that have performed the sort
+		int threads;
+		// The number of parallel tasks spawned while sorting
+		std::size_t tasks;
+		// The number of partitions sorted inline since enough tasks were pending
+		std::size_t inlined;
+		// The engine chosen for the array by its profile and the reason of the choice
+		const char* engine;
+		const char* reason;
+	};
+
+	struct sort_control
+	{
+		// The flag requesting the cooperative cancellation of the sort
+		std::atomic<bool> cancelled;
+		// The flag set once the sort has skipped some of its work because of the cancellation
+		std::atomic<bool> abandoned;
+		// The number of data items placed into their final partitions
+		std::atomic<std::size_t> finalized;
+		// The overall number of data items to be sorted
+		std::size_t total;
+	};
+
+	enum class sort_engine
+	{
+		// The 3-way quicksort partitioning around a single pivot
+		three_way,
+		// The quicksort partitioning around two pivots into three subranges
+		dual_pivot
+	};
+
+	struct sort_context
+	{
+		// The number of threads in the team performing the sort
+		int threads;
+		// The statistics collected while sorting
+		sort_stats stats;
+		// The progress and cancellation state shared with the caller (optional)
+		sort_control* control;
+		// The memory resource of the scratch buffers (optional)
+		memory_resource* scratch;
+		// The partitioning scheme of the quicksort backend
+		sort_engine engine;
+		// The cutoff boundaries tuned for the hardware and the element size
+		sort_tuning tuning;
+		// The size of the partitions below which no more tasks are spawned
+		std::size_t grain;
+		// The number of spawned tasks that haven't completed yet
+		std::size_t pending;
+		// The hardware counters attributed to the phases of the sort (optional)
+		perf_recorder* perf;
+		// The timeline of the tasks performing the sort (optional)
+		sort_tracer* tracer;
+		// The groups of equal keys collected while partitioning (optional)
+		key_groups* groups;
+	};
+
+	inline bool cancelled(const sort_context& ctx)
+	{
+		// Check if the caller has requested to abandon the sort. The sort skips
+		// the rest of its work once this is true, so note that it is left partial
+		if (ctx.control == NULL || !ctx.control->cancelled.load(std::memory_order_relaxed))
+			return false;
 
-	// The lower cutoff boundary
-	const std::size_t cutoff_low = 100;
-	// The higher cutoff boundary
-	const std::size_t cutoff_high = 1000;
+		ctx.control->abandoned.store(true, std::memory_order_relaxed);
+		return true;
+	}
+
+	inline bool abandoned(const sort_context& ctx)
+	{
+		// Check if the sort has skipped some of its work, rather than if the
+		// cancellation has been requested, which might come after the sort is done
+		return ctx.control != NULL && \
+			ctx.control->abandoned.load(std::memory_order_relaxed);
+	}
+
+	inline memory_resource* scratch(const sort_context& ctx)
+	{
+		// Obtain the caller-provided resource of the scratch buffers or the one backed by the huge pages
+		return (ctx.scratch != NULL) ? ctx.scratch : internal::huge_page_memory();
+	}
+
+	template<class BidirIt>
+	sort_tuning tuning_for(BidirIt)
+	{
+		// Obtain the cutoff boundaries of the active profile for the size of the data items
+		return tuning_profile::active().select( \
+			sizeof(typename std::iterator_traits<BidirIt>::value_type));
+	}
+
+	inline void initialize()
+	{
+		// Load the tuning profile and set up the shared pool, the resource of the scratch
+		// buffers and the team of workers ahead of the first sort, so that none of
+		// these is built on its hot path
+		tuning_profile::active();
+		thread_pool::shared(); internal::huge_page_memory();
+		#pragma omp parallel num_threads(omp_get_max_threads())
+		{ }
+	}
+
+	// The number of tasks per thread that keeps the workers busy without flooding the scheduler
+	const std::size_t tasks_per_thread = 8;
+
+	inline std::size_t task_grain(std::size_t size, int threads)
+	{
+		// Split the array into about the given number of tasks per thread at most
+		return size / (internal::tasks_per_thread * std::max(1, threads));
+	}
+
+	inline bool spawn_task(sort_context& ctx, std::size_t size)
+	{
+		// Perform a check if the partition is large enough to be worth a parallel task
+		if (ctx.threads <= 1 || size < ctx.tuning.spawn || size < ctx.grain)
+			return false;
+
+		std::size_t pending = 0L;
+		#pragma omp atomic read
+		pending = ctx.pending;
+
+		// Sort the partition inline if the workers already have enough tasks queued
+		if (pending >= ctx.threads * internal::tasks_per_thread)
+		{
+			#pragma omp atomic
+			ctx.stats.inlined++;
+			return false;
+		}
+
+		#pragma omp atomic
+		ctx.pending++;
+		#pragma omp atomic
+		ctx.stats.tasks++;
+		return true;
+	}
+
+	inline void task_done(sort_context& ctx)
+	{
+		// Account the completion of the task spawned by spawn_task
+		#pragma omp atomic
+		ctx.pending--;
+	}
+
+	inline void finalize(sort_context& ctx, std::size_t count)
+	{
+		// Account the data items that have reached their final positions
+		if (ctx.control != NULL)
+			ctx.control->finalized.fetch_add(count, std::memory_order_relaxed);
+	}
+
+	// The cutoff boundary of the insertion sort within the dual-pivot quicksort
+	const std::size_t cutoff_tiny = 32;
+	// The number of data items the partial insertion sort is allowed to move
+	const std::size_t partial_insertion_limit = 8;
+	// The cutoff boundary above which the pivots are selected from a sample of sqrt(n) items
+	const std::size_t cutoff_sample = 16384;
+	// The maximum number of items in the sample (kept on the stack)
+	const std::size_t max_samples = 1023;
 
 	template<class BidirIt, class _Pred>
 	void sort3v(BidirIt _First, BidirIt _Mid, BidirIt _Last, _Pred compare)
@@ -26,30 +188,37 @@ namespace internal
 			std::iter_swap(_Mid, _Last);
 	}
 
-	template<class BidirIt>
-	BidirIt med3v(BidirIt _First, BidirIt _Mid, BidirIt _Last)
+	template<class BidirIt, class _Pred>
+	bool equivalent(BidirIt _First, BidirIt _Second, _Pred compare)
+	{
+		// Two data items are equal if neither of them is less than the other
+		return !compare(*_First, *_Second) && !compare(*_Second, *_First);
+	}
+
+	template<class BidirIt, class _Pred>
+	BidirIt med3v(BidirIt _First, BidirIt _Mid, BidirIt _Last, _Pred compare)
 	{
-		if ((*_First <= *_Mid && *_First >= *_Last) ||
-			(*_First <= *_Last && *_First >= *_Mid))
-			// Return the first value if it is less than or equal to the middle value
-			return _First;
-		else if ((*_Mid <= *_First && *_Mid >= *_Last) ||
-			(*_Mid <= *_Last && *_Mid >= *_First))
-			// Return the middle value if it is less than or equal to the first value
-			return _Mid;
-		else if ((*_Last <= *_First && *_Last >= *_Mid) ||
-			(*_Last <= *_Mid && *_Last >= *_First))
-			// Return the last value if it is less than or equal to the first value
-			return _Last;
+		// Find the median of three data items by comparing them without any copies
+		if (compare(*_First, *_Mid))
+		{
+			// Return the middle value if it is less than the last value
+			if (compare(*_Mid, *_Last)) return _Mid;
+			// Otherwise, return the greater of the first and the last values
+			return compare(*_First, *_Last) ? _Last : _First;
+		}
 
-		return _First;
+		// Return the first value if it is less than the last value
+		if (compare(*_First, *_Last)) return _First;
+		// Otherwise, return the greater of the middle and the last values
+		return compare(*_Mid, *_Last) ? _Last : _Mid;
 	}
 
-	template<class BidirIt>
-	BidirIt med9v(BidirIt _First, BidirIt _Mid, BidirIt _Last)
+	template<class BidirIt, class _Pred>
+	BidirIt med9v(BidirIt _First, BidirIt _Mid, BidirIt _Last, _Pred compare)
 	{
 		std::size_t _Size = 0L;
-		std::vector<BidirIt> median; median.resize(9);
+		// Keep the sample on the stack, since it's taken at every level of recursion
+		BidirIt median[9];
 
 		// Compute the size of each fragment of the array
 		if ((_Size = (std::distance(_First, _Last) / 9)) >= 3)
@@ -62,32 +231,94 @@ namespace internal
 			     median[index] = _First + _Size * index;
 
 			// Find the median of the first fragment
-			BidirIt _Med1 = med3v(median[0], median[1], median[2]);
+			BidirIt _Med1 = med3v(median[0], median[1], median[2], compare);
 			// Find the median of the second fragment
-			BidirIt _Med2 = med3v(median[3], median[4], median[5]);
+			BidirIt _Med2 = med3v(median[3], median[4], median[5], compare);
 			// Find the median of the third fragment
-			BidirIt _Med3 = med3v(median[6], median[7], median[8]);
+			BidirIt _Med3 = med3v(median[6], median[7], median[8], compare);
 
 			// Compute the final value of the median-of-nine
-			return med3v(_Med1, _Med2, _Med3);
+			return med3v(_Med1, _Med2, _Med3, compare);
 		}
 
 		else {
-			return med3v(_First, _Mid, _Last);
+			return med3v(_First, _Mid, _Last, compare);
 		}
 	}
 
+	template<class RanIt>
+	std::size_t take_sample(RanIt _First, RanIt _Last, RanIt* sample)
+	{
+		// Take an odd number of equally spaced data items, which grows
+		// as the square root of the array size up to the maximum sample size
+		std::size_t _Size = std::distance(_First, _Last) + 1;
+		std::size_t count = std::min(internal::max_samples, \
+			static_cast<std::size_t>(std::sqrt((double)_Size)) | 1);
+
+		std::size_t _Step = _Size / count;
+		for (std::size_t index = 0; index < count; index++)
+			sample[index] = _First + (_Step * index + _Step / 2);
+
+		return count;
+	}
+
+	template<class RanIt, class _Pred>
+	RanIt sample_rank(RanIt* _First, RanIt* _Last, std::size_t rank, _Pred compare)
+	{
+		// Find the item of the given rank within the sample by rearranging
+		// the iterators of the sample rather than the data items themselves
+		std::nth_element(_First, _First + rank, _Last, \
+			[&compare](RanIt a, RanIt b) { return compare(*a, *b); });
+		return _First[rank];
+	}
+
+	template<class RanIt, class _Pred>
+	void sample_pivots(RanIt _First, RanIt _Last, _Pred compare, RanIt& _Lower, RanIt& _Upper)
+	{
+		RanIt sample[internal::max_samples];
+		std::size_t count = internal::take_sample(_First, _Last, sample);
+
+		// Select the median of the sample as the pivot and move it to the first position
+		RanIt _Median = internal::sample_rank(sample, sample + count, count / 2, compare);
+		// Select the lower and upper quartiles of the sample, which are reused
+		// as the pivots of the leftmost and rightmost parts of the array
+		_Lower = internal::sample_rank(sample, sample + count / 2, count / 4, compare);
+		_Upper = internal::sample_rank(sample + count / 2 + 1, \
+			sample + count, count / 4 - 1, compare);
+
+		std::iter_swap(_First, _Median);
+
+		// Drop the quartiles that are equal to the pivot, since they
+		// don't belong to either the leftmost or the rightmost part
+		if (!compare(*_Lower, *_First)) _Lower = _Last + 1;
+		if (!compare(*_First, *_Upper)) _Upper = _Last + 1;
+	}
+
+	template<class RanIt>
+	void track(RanIt& _Tracked, RanIt _Left, RanIt _Right)
+	{
+		// Follow the data item being tracked through the exchange of two items
+		if (_Tracked == _Left) _Tracked = _Right;
+		else if (_Tracked == _Right) _Tracked = _Left;
+	}
+
 	template<class BidirIt, class _Pred>
-	void adjacent_sort(BidirIt _First, BidirIt _Last, _Pred compare)
+	void adjacent_sort(BidirIt _First, BidirIt _Last, _Pred compare, sort_context& ctx)
 	{
 		// Iterate through the array of items in parallel
-		#pragma omp parallel for
-		for (auto _FwdIt = _First; _FwdIt != _Last - 1; _FwdIt++)
+		#pragma omp parallel num_threads(ctx.threads) shared(ctx)
 		{
-			// For each item perform a check if the following item
-			// is greater than the next adjacent item. If so, exchange these items
-			if (!compare(*_FwdIt, *(_FwdIt + 1)) && *_FwdIt != *(_FwdIt + 1))
-				std::iter_swap(_FwdIt, _FwdIt + 1);
+			// Attribute the counters of each worker to the pre-check phase
+			internal::perf_scope scope(ctx.perf, sort_phase::precheck);
+
+			#pragma omp for
+			for (auto _FwdIt = _First; _FwdIt != _Last - 1; _FwdIt++)
+			{
+				// For each item perform a check if the following item
+				// is greater than the next adjacent item. If so, exchange these items
+				if (compare(*(_FwdIt + 1), *_FwdIt))
+					std::iter_swap(_FwdIt, _FwdIt + 1);
+			}
 		}
 	}
 
@@ -105,21 +336,26 @@ namespace internal
 	template<class BidirIt, class _Pred>
 	void do_insertion(BidirIt _First, BidirIt _RevIt, BidirIt _Last, _Pred compare)
 	{
+		// Perform a check if the data item is already in its position
+		if (!compare(*(_RevIt + 1), *_RevIt)) return;
+
+		// Move the data item out of the array, leaving a hole at its position
 		typename std::iterator_traits<BidirIt>::\
-			value_type _Value = *(_RevIt + 1);
+			value_type _Value = std::move(*(_RevIt + 1));
 
 		// Iterate through the array from the current 
 		// position downto the position of the first data item
 	    // For each data item in the subset of previous data items
-		// perform a check if it's greater or equal to the specific 
-		// value of argument
-		while (compare(_Value, *_RevIt))
+		// perform a check if it's greater than the specific 
+		// value of argument. If so, move it into the hole
+		BidirIt _HoleIt = _RevIt + 1;
+		do
 		{
-			// If so, do the insertion of the 
-			// value of argument to the specific position
-			*(_RevIt + 1) = *_RevIt; *_RevIt = _Value;
-			if (_RevIt <= _First) break; _RevIt--;
-		}
+			*_HoleIt = std::move(*_RevIt); _HoleIt = _RevIt;
+		} while (_HoleIt != _First && compare(_Value, *--_RevIt));
+
+		// Move the value of argument into the hole being found
+		*_HoleIt = std::move(_Value);
 	}
 
 	template<class RandomIt, class _Pred>
@@ -128,7 +364,7 @@ namespace internal
 		RandomIt _LeftIt = _First + 1, _RightIt = _Last;
 
 		// Perform the insertion sort by iterating through the array
-		while (_LeftIt <= _RightIt)
+		while (_RightIt - _LeftIt >= 4)
 		{
 			// For each data item make the number of calls 
 			// to the function that performs the actual sorting
@@ -137,97 +373,558 @@ namespace internal
 			do_insertion(_First, _LeftIt - 1, _RightIt, compare); _LeftIt++;
 			do_insertion(_First, _LeftIt - 1, _RightIt, compare); _LeftIt++;
 		}
+
+		// Insert the remaining data items that don't fill the unrolled loop
+		for (; _LeftIt < _RightIt; _LeftIt++)
+			do_insertion(_First, _LeftIt - 1, _RightIt, compare);
+	}
+
+	template<class RandomIt, class _Pred>
+	void leaf_sort(RandomIt _First, RandomIt _Last, _Pred compare, sort_context& ctx)
+	{
+		// Sort the leaf subarray by the insertion sort, attributing the counters to the leaf phase
+		internal::perf_scope scope(ctx.perf, sort_phase::leaf);
+		internal::insertion_sort(_First, _Last, compare);
+	}
+
+	template<class BidirIt, class _Pred>
+	bool sorted(BidirIt _First, BidirIt _Last, std::size_t& pos, _Pred compare, sort_context& ctx)
+	{
+		// Check if the array is already sorted, attributing the counters to the pre-check phase
+		internal::perf_scope scope(ctx.perf, sort_phase::precheck);
+		return misc::sorted(_First, _Last, pos, compare) != 0;
+	}
+
+	template<class RandomIt, class _Pred>
+	bool partial_insertion_sort(RandomIt _First, RandomIt _Last, _Pred compare)
+	{
+		if (_First == _Last) return true;
+
+		std::size_t moves = 0L;
+		// Perform the insertion sort of the array [_First, _Last) and give up
+		// as soon as it has moved more data items than the limit allows,
+		// so that only the nearly sorted arrays are sorted this way
+		for (RandomIt _FwdIt = _First + 1; _FwdIt < _Last; _FwdIt++)
+		{
+			if (!compare(*_FwdIt, *(_FwdIt - 1))) continue;
+
+			RandomIt _HoleIt = _FwdIt;
+			typename std::iterator_traits<RandomIt>::\
+				value_type _Value = std::move(*_HoleIt);
+
+			do
+			{
+				*_HoleIt = std::move(*(_HoleIt - 1)); _HoleIt--; moves++;
+			} while (_HoleIt != _First && compare(_Value, *(_HoleIt - 1)));
+
+			*_HoleIt = std::move(_Value);
+			if (moves > internal::partial_insertion_limit) return false;
+		}
+
+		return true;
+	}
+
+	template<class RandomIt, class _Pred>
+	void heap_sort(RandomIt _First, RandomIt _Last, _Pred compare, sort_context& ctx)
+	{
+		// Sort the array [_First, _Last] by using the heapsort, which guarantees
+		// the O(n log n) complexity regardless of the order of data items
+		if (_First >= _Last) {
+			if (_First == _Last) internal::finalize(ctx, 1);
+			return;
+		}
+
+		std::make_heap(_First, _Last + 1, compare);
+		std::sort_heap(_First, _Last + 1, compare);
+		internal::finalize(ctx, std::distance(_First, _Last) + 1);
+	}
+
+	template<class RandomIt>
+	void break_patterns(RandomIt _First, RandomIt _Last)
+	{
+		// Exchange a few data items of the array [_First, _Last] at the fixed positions,
+		// so that the next choice of pivot doesn't hit the same pattern again
+		std::size_t _Size = std::distance(_First, _Last) + 1;
+		if (_Size < internal::cutoff_tiny) return;
+
+		std::size_t _Quarter = _Size / 4;
+		std::iter_swap(_First, _First + _Quarter);
+		std::iter_swap(_Last, _Last - _Quarter);
+
+		if (_Size > 128)
+		{
+			std::iter_swap(_First + 1, _First + (_Quarter + 1));
+			std::iter_swap(_First + 2, _First + (_Quarter + 2));
+			std::iter_swap(_Last - 1, _Last - (_Quarter + 1));
+			std::iter_swap(_Last - 2, _Last - (_Quarter + 2));
+		}
+	}
+
+	inline int partition_budget(std::size_t _Size)
+	{
+		// Allow as many highly unbalanced partitions as the binary logarithm
+		// of the array size before falling back to the heapsort
+		int budget = 0;
+		while (_Size >>= 1) budget++;
+		return budget;
+	}
+
+	inline bool unbalanced(std::size_t _Size, std::size_t _Largest)
+	{
+		// The partition is highly unbalanced if its largest part
+		// has taken more than 7/8 of the data items
+		return _Largest > _Size - _Size / 8;
 	}
 
 	template<class RanIt, class _Pred>
-        void _qs3w(RanIt _First, RanIt _Last, _Pred compare)
+	void _qs3w(RanIt _First, RanIt _Last, _Pred compare, sort_context& ctx, \
+		int budget, std::ptrdiff_t hint = -1, int depth = 0)
 	{
 		// Check if the array size is not zero
-		if (_First >= _Last) return;
+		if (_First >= _Last)
+		{
+			// A single data item is already in its final position
+			if (_First == _Last) internal::finalize(ctx, 1);
+			return;
+		}
+
+		// Check if the sort has been cancelled at the partition boundary
+		if (internal::cancelled(ctx)) return;
+
+		// Perform a regular insertion sort if the array is a leaf of the recursion
+		if (static_cast<std::size_t>(std::distance(_First, _Last)) < ctx.tuning.leaf)
+		{
+			internal::leaf_sort(_First, _Last + 1, compare, ctx);
+			internal::finalize(ctx, std::distance(_First, _Last) + 1); return;
+		}
 		
 		// Perform a check if the size of the array is equal to 1
 		if (std::distance(_First, _Last) == 1)
 		{
 			// If so, check if the value of the first item is greater
 			// than the value of the last item. If so, exchange these both items
-			if (*_First > *_Last)
+			if (compare(*_Last, *_First))
 				std::iter_swap(_First, _Last);
 
+			internal::finalize(ctx, 2);
+
 			// Terminate the process of sorting
 			return;
 		}
 
+		#pragma omp atomic
+		ctx.stats.depth++;
+
 		// Compute the size of the array to be sorted
-		std::size_t _Size = 0L; g_depth++;
+		std::size_t _Size = 0L;
       		if ((_Size = std::distance(_First, _Last)) > 0)
 		{
+			// Attribute the counters of the pivot selection and partitioning to the partition phase
+			internal::perf_scope partition(ctx.perf, sort_phase::partition);
+
 			// Compute the middle of the array to be sorted
-			RanIt _LeftIt = _First, _RightIt = _Last, 
+			RanIt _LeftIt = _First + 1, _RightIt = _Last, 
 				_MidIt = _First + (_Last - _First) / 2;
 
-			bool is_swapped_left = false, is_swapped_right = false;
-			// Compute the value of median by using median-of-nine algorithm
-			RanIt _Median = internal::med9v(_LeftIt, _MidIt, _RightIt);
-			// Obtain the value of pivot equal to the value of median
-			typename std::iterator_traits<RanIt>::value_type _Pivot = *_Median;
+			// Move the pivot to the first position, so that it's referenced in place
+			// rather than copied, since it stays there while partitioning. The pivot is
+			// either the one suggested by the parent partition, or the median of the
+			// sample of sqrt(n) items for large arrays, or the median-of-nine otherwise
+			RanIt _Lower = _Last + 1, _Upper = _Last + 1;
+			if (hint >= 0)
+				std::iter_swap(_First, _First + hint);
+			else if (_Size + 1 >= internal::cutoff_sample)
+				internal::sample_pivots(_First, _Last, compare, _Lower, _Upper);
+			else std::iter_swap(_First, internal::med9v(_First, _MidIt, _Last, compare));
+
+			// Track the quartiles of the sample through the partitioning (if any)
+			bool is_tracked = (_Lower <= _Last || _Upper <= _Last);
+
+			const typename std::iterator_traits<RanIt>::value_type& _Pivot = *_First;
 
+			bool is_moved = false;
 			// Iterate through the array to be sorted and for each item
 			// perform a check if it's less than the value of pivot
-			for (RanIt _FwdIt = _LeftIt; _FwdIt <= _RightIt; _FwdIt++)
+			for (RanIt _FwdIt = _LeftIt; _FwdIt <= _RightIt; )
 			{
 				// Check if the value of the item is less than the value of pivot
 				if (compare(*_FwdIt, _Pivot))
 				{
 					// If so, exchange the current data item with the next item from left
-					is_swapped_left = true;
-					std::iter_swap(_FwdIt, _LeftIt);
+					if (_FwdIt != _LeftIt) {
+						std::iter_swap(_FwdIt, _LeftIt); is_moved = true;
+						if (is_tracked) {
+							internal::track(_Lower, _FwdIt, _LeftIt);
+							internal::track(_Upper, _FwdIt, _LeftIt);
+						}
+					}
+
 					// Increment the value of pointer to the succeeding data item from left
-					_LeftIt++;
+					_LeftIt++; _FwdIt++;
 				}
 
 				// Check if the value of the item is greater than the value of pivot
-				if (compare(_Pivot, *_FwdIt))
+				else if (compare(_Pivot, *_FwdIt))
 				{
-					is_swapped_right = true;
-					// If so, exchange the current data item with the next item from right
-					std::iter_swap(_FwdIt, _RightIt);
+					// If so, skip the items from right that are already greater than pivot
+					// and exchange the current data item with the next item from right
+					while (_FwdIt < _RightIt && compare(_Pivot, *_RightIt)) _RightIt--;
+					if (_FwdIt != _RightIt) {
+						std::iter_swap(_FwdIt, _RightIt); is_moved = true;
+						if (is_tracked) {
+							internal::track(_Lower, _FwdIt, _RightIt);
+							internal::track(_Upper, _FwdIt, _RightIt);
+						}
+					}
+
 					// Decrement the value of pointer to the succeeding data item from right
-					// and the pointer to the current data item in the array
-					_RightIt--; _FwdIt--;
+					_RightIt--;
+				}
+
+				else _FwdIt++;
+			}
+
+			// Move the pivot next to the items equal to it, exchanging it
+			// with the last item that is less than the value of pivot
+			std::iter_swap(_First, --_LeftIt);
+			if (is_tracked) internal::track(_Lower, _First, _LeftIt);
+			bool is_swapped_left = _LeftIt > _First, is_swapped_right = _RightIt < _Last;
+			partition.stop();
+
+			// The items equal to pivot have reached their final positions and form
+			// the group of equal keys, unless the partitioning at the upper levels
+			// has left some of the equal items outside of the subarray
+			internal::finalize(ctx, std::distance(_LeftIt, _RightIt) + 1);
+			if (ctx.groups != NULL) ctx.groups->record(_LeftIt, _RightIt);
+
+			std::size_t _LeftSize = std::distance(_First, _LeftIt);
+			std::size_t _RightSize = std::distance(_RightIt, _Last);
+
+			// Perform a check if the partition is highly unbalanced (e.g. the pivot
+			// has been chosen badly because of a pattern in the array)
+			if (internal::unbalanced(_Size + 1, std::max(_LeftSize, _RightSize)))
+			{
+				// If so, fall back to the heapsort once the budget has been exhausted
+				if (--budget <= 0)
+				{
+					if (is_swapped_left) internal::heap_sort(_First, _LeftIt - 1, compare, ctx);
+					if (is_swapped_right) internal::heap_sort(_RightIt + 1, _Last, compare, ctx);
+					return;
+				}
+
+				// Otherwise, break the pattern of both parts of the array
+				if (is_swapped_left) internal::break_patterns(_First, _LeftIt - 1);
+				if (is_swapped_right) internal::break_patterns(_RightIt + 1, _Last);
+				_Lower = _Upper = _Last + 1;
+			}
+
+			// Perform a check if the partitioning hasn't moved any data items
+			// (e.g. the array is nearly sorted). If so, try to finish both parts
+			// by the partial insertion sort, which gives up unless it's cheap
+			else if (is_moved == false)
+			{
+				if (internal::partial_insertion_sort(_First, _LeftIt, compare) && \
+					internal::partial_insertion_sort(_RightIt + 1, _Last + 1, compare))
+				{
+					internal::finalize(ctx, _LeftSize + _RightSize);
+					return;
 				}
+
+				_Lower = _Upper = _Last + 1;
 			}
 
-			// Perform a check if the size is greater than 
-			// the value of the higher cutting off boundary
-			if (_Size >= internal::cutoff_high)
+			// Suggest the quartiles of the sample as the pivots of both parts
+			std::ptrdiff_t _LeftHint = (_Lower <= _Last) ? std::distance(_First, _Lower) : -1;
+			std::ptrdiff_t _RightHint = (_Upper <= _Last) ? std::distance(_RightIt + 1, _Upper) : -1;
+
+			// Launch a parallel task to sort the smaller part of the array (excluding
+			// the items equal to pivot) if it's large enough and not too many tasks are
+			// pending, and sort the larger part inline within the current task, so that
+			// the number of tasks stays proportional to the number of threads
+			if (_LeftSize <= _RightSize)
 			{
-				// If so, launch parallel tasks to sort 
-				// the either leftmost or rightmost part of the array
-				#pragma omp task untied mergeable
-				if (std::distance(_First, _LeftIt) > 0 && is_swapped_left)
-					internal::_qs3w(_First, _LeftIt, compare);
-
-				#pragma omp task untied mergeable
-				if (std::distance(_RightIt, _Last) > 0 && is_swapped_right)
-					internal::_qs3w(_RightIt, _Last, compare);
+				if (is_swapped_left && internal::spawn_task(ctx, _LeftSize))
+				{
+					#pragma omp task untied mergeable shared(ctx)
+					{
+						internal::trace_scope trace(ctx.tracer, "_qs3w", sort_phase::partition, _LeftSize, depth + 1);
+						internal::_qs3w(_First, _LeftIt - 1, compare, ctx, budget, _LeftHint, depth + 1);
+						internal::task_done(ctx);
+					}
+				}
+
+				else if (is_swapped_left)
+					internal::_qs3w(_First, _LeftIt - 1, compare, ctx, budget, _LeftHint, depth + 1);
+
+				if (is_swapped_right)
+					internal::_qs3w(_RightIt + 1, _Last, compare, ctx, budget, _RightHint, depth + 1);
 			}
 
 			else
 			{
-				// Otherwise, merge the two concurrent parallel tasks into a single parallel task
-				// in which the leftmost and rightmost parts are sorted sequentially
-				#pragma omp parallel num_threads(12)
-				#pragma omp single nowait
+				if (is_swapped_right && internal::spawn_task(ctx, _RightSize))
 				{
-					if (std::distance(_First, _LeftIt) > 0 && is_swapped_left)
-						internal::_qs3w(_First, _LeftIt, compare);
-					if (std::distance(_RightIt, _Last) > 0 && is_swapped_right)
-						internal::_qs3w(_RightIt, _Last, compare);
+					#pragma omp task untied mergeable shared(ctx)
+					{
+						internal::trace_scope trace(ctx.tracer, "_qs3w", sort_phase::partition, _RightSize, depth + 1);
+						internal::_qs3w(_RightIt + 1, _Last, compare, ctx, budget, _RightHint, depth + 1);
+						internal::task_done(ctx);
+					}
 				}
+
+				else if (is_swapped_right)
+					internal::_qs3w(_RightIt + 1, _Last, compare, ctx, budget, _RightHint, depth + 1);
+
+				if (is_swapped_left)
+					internal::_qs3w(_First, _LeftIt - 1, compare, ctx, budget, _LeftHint, depth + 1);
 			}
 		}
 	}
 
+	template<class RanIt, class _Pred>
+	void _qs3w(RanIt _First, RanIt _Last, _Pred compare, sort_context& ctx)
+	{
+		// Start the 3-way quicksort with the full budget of unbalanced partitions
+		internal::_qs3w(_First, _Last, compare, ctx, \
+			internal::partition_budget(std::distance(_First, _Last) + 1));
+	}
+
+	template<class RanIt, class _Pred>
+	void _qsdp(RanIt _First, RanIt _Last, _Pred compare, sort_context& ctx, int budget, int depth = 0)
+	{
+		// Check if the array size is not zero
+		if (_First >= _Last)
+		{
+			// A single data item is already in its final position
+			if (_First == _Last) internal::finalize(ctx, 1);
+			return;
+		}
+
+		// Check if the sort has been cancelled at the partition boundary
+		if (internal::cancelled(ctx)) return;
+
+		// Compute the size of the array to be sorted and perform
+		// a regular insertion sort if it's too small to be partitioned
+		std::size_t _Size = std::distance(_First, _Last) + 1;
+		if (_Size <= std::max(internal::cutoff_tiny, ctx.tuning.leaf))
+		{
+			internal::leaf_sort(_First, _Last + 1, compare, ctx);
+			internal::finalize(ctx, _Size); return;
+		}
+
+		#pragma omp atomic
+		ctx.stats.depth++;
+
+		// Attribute the counters of the pivot selection and partitioning to the partition phase
+		internal::perf_scope partition(ctx.perf, sort_phase::partition);
+
+		RanIt _Lower = _First, _Upper = _Last;
+		if (_Size >= internal::cutoff_sample)
+		{
+			// Take the sample of sqrt(n) items for large arrays and select
+			// its tertiles, so that the pivots split the array into equal parts
+			RanIt sample[internal::max_samples];
+			std::size_t count = internal::take_sample(_First, _Last, sample);
+			_Upper = internal::sample_rank(sample, sample + count, count * 2 / 3, compare);
+			_Lower = internal::sample_rank(sample, sample + count * 2 / 3, count / 3, compare);
+		}
+
+		else
+		{
+			// Take the sample of nine equally spaced data items (as the median-of-nine
+			// algorithm does) and sort it, so that the pivots split the array into tertiles
+			RanIt sample[9]; std::size_t _Step = _Size / 9;
+			for (int index = 0; index < 9; index++)
+			{
+				sample[index] = _First + _Step * index + _Step / 2;
+				for (int pos = index; pos > 0 && compare(*sample[pos], *sample[pos - 1]); pos--)
+					std::iter_swap(sample[pos], sample[pos - 1]);
+			}
+
+			_Lower = sample[2]; _Upper = sample[6];
+		}
+
+		// Move both pivots to the ends of the array, so that they are referenced
+		// in place rather than copied, since they stay there while partitioning
+		std::iter_swap(_First, _Lower); std::iter_swap(_Last, _Upper);
+		const typename std::iterator_traits<RanIt>::value_type& _Pivot1 = *_First;
+		const typename std::iterator_traits<RanIt>::value_type& _Pivot2 = *_Last;
+
+		// Perform a check if both pivots are equal (e.g. the array has many duplicates).
+		// If so, the 3-way partitioning is more appropriate to gather the equal items
+		if (!compare(_Pivot1, _Pivot2))
+		{
+			internal::_qs3w(_First, _Last, compare, ctx, budget, -1, depth);
+			return;
+		}
+
+		bool is_moved = false;
+		// Partition the array into the items less than the first pivot,
+		// the items between both pivots and the items greater than the second pivot
+		RanIt _LeftIt = _First + 1, _RightIt = _Last - 1;
+		for (RanIt _FwdIt = _LeftIt; _FwdIt <= _RightIt; _FwdIt++)
+		{
+			// Check if the value of the item is less than the value of the first pivot
+			if (compare(*_FwdIt, _Pivot1))
+			{
+				// If so, exchange the current data item with the next item from left
+				if (_FwdIt != _LeftIt) {
+					std::iter_swap(_FwdIt, _LeftIt); is_moved = true;
+				}
+
+				_LeftIt++;
+			}
+
+			// Check if the value of the item is greater than the value of the second pivot
+			else if (compare(_Pivot2, *_FwdIt))
+			{
+				// If so, skip the items from right that are greater than the second pivot
+				// and exchange the current data item with the next item from right
+				while (_FwdIt < _RightIt && compare(_Pivot2, *_RightIt)) _RightIt--;
+				if (_FwdIt != _RightIt) {
+					std::iter_swap(_FwdIt, _RightIt); is_moved = true;
+				}
+
+				_RightIt--;
+
+				// The item obtained from right might be less than the first pivot
+				if (compare(*_FwdIt, _Pivot1))
+				{
+					if (_FwdIt != _LeftIt) {
+						std::iter_swap(_FwdIt, _LeftIt); is_moved = true;
+					}
+
+					_LeftIt++;
+				}
+			}
+		}
+
+		// Move both pivots to their final positions between the subranges
+		std::iter_swap(_First, --_LeftIt); std::iter_swap(_Last, ++_RightIt);
+		internal::finalize(ctx, 2);
+
+		// The middle subrange is bounded by the pivots at their final positions
+		RanIt _MidFirst = _LeftIt + 1, _MidLast = _RightIt - 1;
+
+		// Perform a check if the middle subrange is too large (e.g. most items are equal
+		// to either pivot). If so, gather the items equal to the first pivot at its left
+		// end and the items equal to the second pivot at its right end, since these
+		// items have already reached their final positions
+		if (std::distance(_MidFirst, _MidLast) + 1 > std::ptrdiff_t(_Size * 4 / 7))
+		{
+			const typename std::iterator_traits<RanIt>::value_type& _Lower = *_LeftIt;
+			const typename std::iterator_traits<RanIt>::value_type& _Upper = *_RightIt;
+
+			for (RanIt _FwdIt = _MidFirst; _FwdIt <= _MidLast; _FwdIt++)
+			{
+				// Check if the item is equal to the first pivot (it's not less than it)
+				if (!compare(_Lower, *_FwdIt))
+				{
+					std::iter_swap(_FwdIt, _MidFirst); _MidFirst++;
+				}
+
+				// Check if the item is equal to the second pivot (it's not greater than it)
+				else if (!compare(*_FwdIt, _Upper))
+				{
+					while (_FwdIt < _MidLast && !compare(*_MidLast, _Upper)) _MidLast--;
+					std::iter_swap(_FwdIt, _MidLast); _MidLast--;
+
+					if (!compare(_Lower, *_FwdIt))
+					{
+						std::iter_swap(_FwdIt, _MidFirst); _MidFirst++;
+					}
+				}
+			}
+
+			internal::finalize(ctx, std::distance(_LeftIt, _MidFirst) - 1 + \
+				std::distance(_MidLast, _RightIt) - 1);
+		}
+
+		partition.stop();
+
+		std::size_t _LeftSize = std::distance(_First, _LeftIt);
+		std::size_t _MidSize = std::distance(_MidFirst, _MidLast + 1);
+		std::size_t _RightSize = std::distance(_RightIt, _Last);
+
+		// Perform a check if the partition is highly unbalanced (e.g. the pivots
+		// have been chosen badly because of a pattern in the array)
+		if (internal::unbalanced(_Size, std::max(_MidSize, std::max(_LeftSize, _RightSize))))
+		{
+			// If so, fall back to the heapsort once the budget has been exhausted
+			if (--budget <= 0)
+			{
+				internal::heap_sort(_First, _LeftIt - 1, compare, ctx);
+				internal::heap_sort(_MidFirst, _MidLast, compare, ctx);
+				internal::heap_sort(_RightIt + 1, _Last, compare, ctx);
+				return;
+			}
+
+			// Otherwise, break the pattern of all subranges of the array
+			if (_LeftSize > 0) internal::break_patterns(_First, _LeftIt - 1);
+			if (_MidSize > 0) internal::break_patterns(_MidFirst, _MidLast);
+			if (_RightSize > 0) internal::break_patterns(_RightIt + 1, _Last);
+		}
+
+		// Perform a check if the partitioning hasn't moved any data items
+		// (e.g. the array is nearly sorted). If so, try to finish all subranges
+		// by the partial insertion sort, which gives up unless it's cheap
+		else if (is_moved == false && \
+			internal::partial_insertion_sort(_First, _LeftIt, compare) && \
+			internal::partial_insertion_sort(_MidFirst, _MidLast + 1, compare) && \
+			internal::partial_insertion_sort(_RightIt + 1, _Last + 1, compare))
+		{
+			internal::finalize(ctx, _LeftSize + _MidSize + _RightSize);
+			return;
+		}
+
+		RanIt _Parts[3][2] = { { _First, _LeftIt - 1 }, { _MidFirst, _MidLast }, { _RightIt + 1, _Last } };
+		std::size_t _Sizes[3] = { _LeftSize, _MidSize, _RightSize };
+		std::size_t largest = std::max_element(_Sizes, _Sizes + 3) - _Sizes;
+
+		// Launch parallel tasks to sort the two smaller subranges if they're large
+		// enough and not too many tasks are pending, and sort the largest subrange
+		// inline within the current task, so that the number of tasks stays
+		// proportional to the number of threads
+		for (std::size_t part = 0; part < 3; part++)
+		{
+			if (part == largest) continue;
+
+			RanIt _PartFirst = _Parts[part][0], _PartLast = _Parts[part][1];
+			if (internal::spawn_task(ctx, _Sizes[part]))
+			{
+				#pragma omp task untied mergeable shared(ctx)
+				{
+					internal::trace_scope trace(ctx.tracer, "_qsdp", sort_phase::partition, _Sizes[part], depth + 1);
+					internal::_qsdp(_PartFirst, _PartLast, compare, ctx, budget, depth + 1);
+					internal::task_done(ctx);
+				}
+			}
+
+			else internal::_qsdp(_PartFirst, _PartLast, compare, ctx, budget, depth + 1);
+		}
+
+		internal::_qsdp(_Parts[largest][0], _Parts[largest][1], compare, ctx, budget, depth + 1);
+	}
+
+	template<class RanIt, class _Pred>
+	void _qsdp(RanIt _First, RanIt _Last, _Pred compare, sort_context& ctx)
+	{
+		// Start the dual-pivot quicksort with the full budget of unbalanced partitions
+		internal::_qsdp(_First, _Last, compare, ctx, \
+			internal::partition_budget(std::distance(_First, _Last) + 1));
+	}
+
+	template<class RanIt, class _Pred>
+	void quick_sort(RanIt _First, RanIt _Last, _Pred compare, sort_context& ctx, int depth = 0)
+	{
+		// Sort the array [_First, _Last] by using the quicksort backend selected by the caller,
+		// starting with the full budget of unbalanced partitions
+		int budget = internal::partition_budget(std::distance(_First, _Last) + 1);
+		if (ctx.engine == sort_engine::dual_pivot)
+			internal::_qsdp(_First, _Last, compare, ctx, budget, depth);
+		else internal::_qs3w(_First, _Last, compare, ctx, budget, -1, depth);
+	}
+
 	template<class BidirIt, class _Pred >
 	inline std::pair<BidirIt, BidirIt> partition(BidirIt _First, \
 		BidirIt _Last, _Pred compare)
@@ -237,7 +934,7 @@ namespace internal
 		// then perform a tiny sort by exchanging the adjacent data items
 		if ((_Size = std::distance(_First, _Last)) == 1)
 		{
-			if (!compare(*_First, *_Last))
+			if (compare(*_Last, *_First))
 				std::iter_swap(_First, _Last);
 
 			// Return the pair of pointers to the two subsequent
@@ -264,246 +961,283 @@ namespace internal
 		// Perform a tiny sort of three values at the middle of the array
 		internal::sort3v(_MidIt - 1, _MidIt, _MidIt + 1, compare);
 
-		// Compute the median by using median-of-nine algorithm
-		BidirIt _Median = internal::med9v(_LeftIt, _MidIt, _RightIt);
-		// Obtain the value of pivot based on the value of median
-		typename std::iterator_traits<BidirIt>::value_type _Pivot = *_Median;
-
-		// Perform a check if the first data item is equal to the value of median
-		if (*_First == _Pivot)
-			// If so, swap it with the middle data item
-			std::iter_swap(_First, _MidIt);
-
-		// Perform a check if the last data item is equal to the value of median
-		if (*_Last == _Pivot)
-			// If so, swap it with the middle data item
-			std::iter_swap(_Last, _MidIt);
+		// Compute the median by using median-of-nine algorithm and move it
+		// to the first position, so that the pivot is referenced in place rather
+		// than copied, since it stays there until the partitioning is done
+		std::iter_swap(_First, internal::med9v(_LeftIt, _MidIt, _RightIt, compare));
+		const typename std::iterator_traits<BidirIt>::value_type& _Pivot = *_First;
 
 		// Perform partitioning iteratively until we've re-arranged the array to be sorted
 		// and obtained the pointers to the leftmost and rightmost partitions.
-		while (_LeftIt <= _RightIt)
+		for (_LeftIt = _First + 1; ; _LeftIt++, _RightIt--)
 		{
-			// Iterate through the array from left and for each data item
-			// perform a check if it's greater than the value of pivot
-			for (; _LeftIt <= _Last; _LeftIt++)
-			{
-				// Perform a check if the value of the current 
-				// data item is greater than the value of pivot or is equal to it 
-				if (compare(_Pivot, *_LeftIt) || _Pivot == *_LeftIt)
-				{
-					// If so, perform the iteration through the array from the right
-					// until we've reached the data item which is already found from left
-					// For each item perform a check if it's not less than the value of pivot
-					for (; _RightIt >= _LeftIt; _RightIt--)
-					{
-						// If the current item's value is less than the value of pivot or 
-						// at least equal to it, exchange the specific data item being found
-						if (compare(*_RightIt, _Pivot) || _Pivot == *_RightIt)
-						{
-							// Perform a check if the value of the pointer obtained from left
-							// is less than or equal to the value of pointer from the right
-							if (_LeftIt <= _RightIt)
-							{
-								// If so, exchange the specific data items
-								std::iter_swap(_LeftIt, _RightIt);
-								// Increment the pointer to the left item and 
-								// decrement the pointer to the right item
-								_LeftIt++; _RightIt--;
-							}
-
-							// Terminate the loop execution
-							break;
-						}
-					}
+			// Iterate through the array from left and stop at the first data item
+			// that is greater than the value of pivot or is equal to it
+			while (_LeftIt <= _RightIt && compare(*_LeftIt, _Pivot)) _LeftIt++;
+			// Iterate through the array from right and stop at the first data item
+			// that is less than the value of pivot or is equal to it
+			while (_LeftIt <= _RightIt && compare(_Pivot, *_RightIt)) _RightIt--;
 
-					// Terminate the loop execution
-					break;
-				}
-			}
+			// Terminate the loop execution once both pointers have met
+			if (_LeftIt >= _RightIt) break;
+			// Otherwise, exchange the specific data items
+			std::iter_swap(_LeftIt, _RightIt);
 		}
 
+		// Move the pivot to its final position, exchanging it with
+		// the last data item that is not greater than the value of pivot
+		std::iter_swap(_First, _RightIt);
+
 		// Return the pair of pointers to the two subsequent
 		// partitions in the array to be sorted
-		return std::make_pair(_LeftIt, _RightIt);
+		return std::make_pair(_RightIt + 1, _RightIt - 1);
 	}
 
 	template<class BidirIt, class _Pred >
-	void intro_sort(BidirIt _First, BidirIt _Last, _Pred compare)
+	void intro_sort(BidirIt _First, BidirIt _Last, _Pred compare, sort_context& ctx)
 	{
 		// Check if the array size is not zero
 		if (_First >= _Last) return;
 
-		std::size_t pos = 0L; g_depth++;
+		// Check if the sort has been cancelled at the partition boundary
+		if (internal::cancelled(ctx)) return;
+
+		// Trace the sort of the entire array or the chunk as a whole
+		internal::trace_scope trace(ctx.tracer, "intro_sort", \
+			sort_phase::partition, std::distance(_First, _Last) + 1, 0);
+
+		#pragma omp atomic
+		ctx.stats.depth++;
+
+		std::size_t pos = 0L;
 		// Perform a check if the array has already been sorted.
 		// If so terminate the process of sorting
-		if (misc::sorted(_First, _Last, pos, compare)) return;
+		if (internal::sorted(_First, _Last + 1, pos, compare, ctx)) {
+			internal::finalize(ctx, std::distance(_First, _Last) + 1); return;
+		}
 
 		std::size_t _Size = 0L;
 		// Compute the actual size of the array and perform a check
 		// if the size does not exceed a lower cutting off boundary
-		if ((_Size = std::distance(_First, _Last)) > internal::cutoff_low)
+		if ((_Size = std::distance(_First, _Last)) > ctx.tuning.leaf)
 		{
 			BidirIt _LeftIt = _First, _RightIt = _Last;
 
 			// If so, partition the array by using Hoare's quicksort partitioning
+			internal::perf_scope partition(ctx.perf, sort_phase::partition);
 			std::pair<BidirIt, BidirIt> p \
 				= internal::partition(_First, _Last, compare);
+			partition.stop();
 
-			// Perform a check if the size of the array does not 
-			// exceed the higher cutting off boundary
-			if (_Size > internal::cutoff_high)
+			// The items between both partitions have reached their final positions
+			if (std::distance(p.second, p.first) > 1)
+				internal::finalize(ctx, std::distance(p.second, p.first) - 1);
+
+			// Compute the sizes of both partitions (that might be empty)
+			std::size_t _LeftSize = std::max(std::ptrdiff_t(0), std::distance(_First, p.second) + 1);
+			std::size_t _RightSize = std::max(std::ptrdiff_t(0), std::distance(p.first, _Last) + 1);
+
+			// Launch a parallel task that will perform the improved 3-way quicksort
+			// of the smaller partition at the backend, if the granularity control
+			// allows spawning it, and sort the larger partition within the current task
+			if (_LeftSize <= _RightSize)
 			{
-				// If not, launch the first parallel task 
-				// that will perform the improved 3-way quicksort at the backend
-				#pragma omp task untied mergeable
-				// Perform a check if the size of the partition is not zero and
-				// we're not performing an empty null-task
-				if (std::distance(p.first, _Last) > 0)
-					internal::_qs3w(p.first, _Last, compare);
-
-				// If not, launch the second parallel task 
-				// that will perform the improved 3-way quicksort at the backend
-				#pragma omp task untied mergeable
-				// Perform a check if the size of the partition is not zero and
-				// we're not performing an empty null-task
-				if (std::distance(_First, p.second) > 0)
-					internal::_qs3w(_First, p.second, compare);
+				if (_LeftSize > 1 && internal::spawn_task(ctx, _LeftSize))
+				{
+					#pragma omp task untied mergeable shared(ctx)
+					{
+						internal::trace_scope trace(ctx.tracer, "quick_sort", sort_phase::partition, _LeftSize, 1);
+						internal::quick_sort(_First, p.second, compare, ctx, 1);
+						internal::task_done(ctx);
+					}
+				}
+
+				else if (_LeftSize > 1)
+					internal::quick_sort(_First, p.second, compare, ctx, 1);
+
+				if (_RightSize > 1)
+					internal::quick_sort(p.first, _Last, compare, ctx, 1);
 			}
 
 			else
 			{
-				// Otherwise, merge the two concurrent parallel tasks into a single parallel task
-				// in which calls to the sorter routine are performed sequentially
-				#pragma omp parallel num_threads(12)
-				#pragma omp single nowait
+				if (_RightSize > 1 && internal::spawn_task(ctx, _RightSize))
 				{
-					if (std::distance(p.first, _Last) > 0)
-						internal::_qs3w(p.first, _Last, compare);
-					if (std::distance(_First, p.second) > 0)
-						internal::_qs3w(_First, p.second, compare);
+					#pragma omp task untied mergeable shared(ctx)
+					{
+						internal::trace_scope trace(ctx.tracer, "quick_sort", sort_phase::partition, _RightSize, 1);
+						internal::quick_sort(p.first, _Last, compare, ctx, 1);
+						internal::task_done(ctx);
+					}
 				}
+
+				else if (_RightSize > 1)
+					internal::quick_sort(p.first, _Last, compare, ctx, 1);
+
+				if (_LeftSize > 1)
+					internal::quick_sort(_First, p.second, compare, ctx, 1);
 			}
 		}
 
 		else
 		{
 			// If the size of the array is less than 10^2, 
-			// perform a regular insertion sort launched 
-			// during the parallel task execution
-			#pragma omp parallel num_threads(12)
-			#pragma omp single nowait
-			{
-				if (std::distance(_First, _Last) > 0)
-					internal::insertion_sort(_First, _Last + 1, compare);
-			}
+			// perform a regular insertion sort within the current task
+			if (std::distance(_First, _Last) > 0)
+				internal::leaf_sort(_First, _Last + 1, compare, ctx);
+
+			internal::finalize(ctx, std::distance(_First, _Last) + 1);
 		}
 	}
 
 	template<class BidirIt, class _Pred >
-	void parallel_sort1(BidirIt _First, BidirIt _Last, _Pred compare)
+	void parallel_sort1(BidirIt _First, BidirIt _Last, _Pred compare, sort_context& ctx)
+	{
+		// Launch a parallel task to perform an introspective sort of the entire array
+		#pragma omp parallel num_threads(ctx.threads) shared(ctx)
+		#pragma omp master
+			internal::intro_sort(_First, _Last - 1, compare, ctx);
+	}
+
+	template<class RanIt>
+	void parallel_reverse(RanIt _First, RanIt _Last, int threads)
+	{
+		// Exchange the data items of both halves of the array pairwise, by all threads at once
+		std::int64_t _Size = std::distance(_First, _Last);
+		#pragma omp parallel for num_threads(threads) schedule(static)
+		for (std::int64_t index = 0; index < _Size / 2; index++)
+			std::iter_swap(_First + index, _First + (_Size - index - 1));
+	}
+
+	inline void dispatch(sort_context& ctx, const char* engine, const char* reason)
+	{
+		// Report the engine chosen for the array and the reason of the choice
+		ctx.stats.engine = engine; ctx.stats.reason = reason;
+	}
+
+	// The ratio of the size to the estimated number of distinct keys above which
+	// the array is sorted by the quicksort that gathers the equal keys
+	const std::size_t duplicate_ratio = 16;
+	// The average length of the ascending runs above which the array is
+	// sorted by the quicksort that finishes the runs by the insertion sort
+	const std::size_t run_length = 16;
+
+	template<class BidirIt, class _Pred >
+	void parallel_sort(BidirIt _First, BidirIt _Last, _Pred compare, sort_context& ctx)
 	{
+		std::size_t pos = 0L;
 		// Compute the potential size of the array to be sorted
 		std::size_t _Size = std::distance(_First, _Last);
-		// Find the value of the maximum data item in the array
-		typename std::iterator_traits<BidirIt>::value_type \
-			_MaxValue = *std::max_element(_First, _Last);
-
-		// Compute the radix MSD position for the size value
-		std::size_t _MaxSizeRadix  = std::log10((double)_Size);
-		// Compute the radix MSD position for the maximum value
-		std::size_t _MaxValueRadix = std::log10((double)_MaxValue);
-
-		// Perform a check if the MSD position of the size is greater
-		// (e.g. the array is an interleave sequence)
-		if (_MaxSizeRadix > _MaxValueRadix)
-		{
-			// Partition the entire array into chunks of a fixed size
-			// based on finding sub-intervals for each particular chunk
-			misc::partitioner p(std::make_pair(0, _Size), \
-				omp_get_max_threads());
-
-			// Execute a parallel region in which the introspective sorter
-			// function is invoked for each particular chunks to be sorted
-			#pragma omp parallel num_threads(12)
-			{
-				volatile int tid = omp_get_thread_num();
-				internal::intro_sort(_First + p[tid].first(),
-					_First + p[tid].second(), compare);
-			}
+		// Arrays of less than two items are already sorted
+		if (_Size < 2) {
+			internal::dispatch(ctx, "none", "less than two items"); return;
+		}
 
-			// Perform a parallel task to perform a final sort that
-			// will arrange the entire array into an ordered sequence
-			#pragma omp parallel num_threads(12)
-			#pragma omp master
-				internal::intro_sort(_First, _Last - 1, compare);
+		// Profile the array by a single parallel pass: the order of the adjacent
+		// items, the range of keys and the estimated number of distinct keys
+		internal::perf_scope precheck(ctx.perf, sort_phase::precheck);
+		input_profile profile = internal::profile(_First, _Last, compare, ctx.threads);
+		precheck.stop();
+
+		if (profile.is_sorted()) {
+			internal::dispatch(ctx, "none", "already sorted"); return;
 		}
-		
-		else
+
+		if (profile.is_reversed()) {
+			internal::parallel_reverse(_First, _Last, ctx.threads);
+			internal::dispatch(ctx, "reverse", "sorted in the reverse order"); return;
+		}
+
+		// Sort the integral keys of a small range (e.g. the status codes or the
+		// binary sequence) by counting them in a single pass over the array
+		if (internal::counting_sort(_First, _Last, compare, ctx.threads, profile, internal::scratch(ctx))) {
+			internal::dispatch(ctx, "counting_sort", "small range of integral keys"); return;
+		}
+
+		// Perform the 3-way quicksort if the array has lots of duplicates (e.g. the array
+		// is an interleave sequence), since each key is gathered into a single band, or
+		// if the array consists of long ascending runs, since the partitions that
+		// move no data items are finished by the partial insertion sort
+		bool is_duplicated = profile.distinct * internal::duplicate_ratio <= _Size;
+		bool is_presorted = profile.runs * internal::run_length <= _Size;
+		if (is_duplicated || is_presorted)
 		{
-			// Otherwise, launch a parallel task to perform 
-			// an introspective sort of the entire array
-			#pragma omp parallel num_threads(12)
+			internal::dispatch(ctx, (ctx.engine == sort_engine::dual_pivot) ? "dual_pivot" : "three_way", \
+				is_duplicated ? "lots of duplicate keys" : "long ascending runs");
+
+			// Perform the parallel task that executes
+			// the 3-way quicksort routine at the backend
+			#pragma omp parallel num_threads(ctx.threads) shared(ctx)
 			#pragma omp master
-				internal::intro_sort(_First, _Last - 1, compare);
+			{
+				internal::trace_scope trace(ctx.tracer, "quick_sort", sort_phase::partition, _Size, 0);
+				internal::quick_sort(_First, _Last - 1, compare, ctx);
+			}
+
+			return;
 		}
-	}
 
-	template<class BidirIt, class _Pred >
-	void parallel_sort(BidirIt _First, BidirIt _Last, _Pred compare)
-	{
-		std::size_t pos = 0L; g_depth = 0L;
-		// Compute the potential size of the array to be sorted
-		std::size_t _Size = std::distance(_First, _Last);
+		internal::dispatch(ctx, "intro_sort", "distinct keys in short runs");
 
 		// Perform the parallel cocktail shaker sort
+		internal::perf_scope presort(ctx.perf, sort_phase::precheck);
 		#pragma omp task untied mergeable
 			internal::shaker_sort(_First, _Last - 1, compare);
 
 		// Synchronize threads until the parallel task has completed its execution
 		#pragma omp taskwait
-		
-		// Let's give a first chance check if the array has already been sorted and
-		// obtain the position of the first unsorted data item
-		if (!misc::sorted(_First, _Last, pos, compare))
+		presort.stop();
+
+		// Execute a loop to sort the array by performing the introspective sort
+		// over again until the entire array is sorted
+		while (!internal::cancelled(ctx) && !internal::sorted(_First, _Last, pos, compare, ctx))
 		{
-			BidirIt _LeftIt = _First, _RightIt = _First + pos;
+			// Perform the pre-sorting of the array by using adjacent sort
+			internal::adjacent_sort(_First, _Last, compare, ctx);
+			// Perform the actual sorting by launching the introspective sort
+			internal::parallel_sort1(_First, _Last, compare, ctx);
+		}
+	}
 
-			// Compute the radix MSD position for the size value
-			std::size_t _MaxSizeRadix  = std::log10((double)_Size);
-			// Compute the radix MSD position for the maximum value
-			std::size_t _MaxValueRadix = std::log10((double)*_RightIt);
+	template<class BidirIt, class _Pred >
+	void parallel_sort(BidirIt _First, BidirIt _Last, _Pred compare, sort_stats& stats, \
+		thread_pool& pool = thread_pool::shared(), sort_control* control = NULL, \
+		memory_resource* scratch = NULL, sort_engine engine = sort_engine::three_way, \
+		const sort_tuning* tuning = NULL, perf_recorder* perf = NULL, sort_tracer* tracer = NULL, \
+		key_groups* groups = NULL)
+	{
+		// Use the cutoff boundaries of the active profile unless the caller has given its own
+		sort_tuning cutoffs = (tuning != NULL) ? *tuning : internal::tuning_for(_First);
 
-			// Perform a check if the MSD position of the size is greater
-			if (_MaxSizeRadix > _MaxValueRadix)
-			{
-				// If so, perform a check if the value of the first data item is
-				// equal to the value of the first unsorted item that occurs in the array
-				// (e.g. the array is an interleave sequence)
-				if (*_LeftIt == *(_RightIt + 1))
-				{
-					// Perform the parallel task that executes 
-					// the 3-way quicksort routine at the backend
-					#pragma omp parallel num_threads(12)
-					#pragma omp master
-						internal::_qs3w(_First, _Last - 1, compare);
-				
-					// Terminate the process of sorting.
-					return;
-				}
-			}
+		// Draw the workers from the pool shared by all concurrent callers, so that
+		// the overall number of threads never exceeds the pool size. The arrays
+		// below the parallel cutoff boundary are sorted by a single thread
+		std::size_t _Size = std::distance(_First, _Last);
+		pool_lease lease(pool, (_Size < cutoffs.parallel) ? 1 : omp_get_max_threads());
 
-			// Otherwise, if the array is not an interleave sequence
-			// execute a loop to sort the array by performing the introspective sort
-			do
-			{
-				// Perform the pre-sorting of the array by using adjacent sort
-				internal::adjacent_sort(_First, _Last, compare);
-				// Perform the actual sorting by launching the introspective sort
-				internal::parallel_sort1(_First, _Last, compare);
-			  // Perform the last chance check if the array has already been sorted
-			  // If not, proceed with the process of sorting over again until the entire array is sorted
-			} while (!misc::sorted(_First, _Last, pos, compare));
-		}
+		// Keep the whole state of the sort local to this call
+		sort_context ctx = { lease.size(), sort_stats(), control, scratch, engine, cutoffs, \
+			internal::task_grain(_Size, lease.size()), 0L, perf, tracer, groups };
+		if (groups != NULL) groups->bind(_First, lease.size());
+
+		internal::parallel_sort(_First, _Last, compare, ctx);
+
+		// Complete the groups of equal keys by scanning the ranges they don't cover
+		if (groups != NULL && !internal::abandoned(ctx))
+			groups->complete(_First, _Last, compare, lease.size());
+
+		// Report the entire array as sorted unless the sort has been abandoned
+		if (control != NULL && !internal::abandoned(ctx))
+			control->finalized = control->total;
+
+		stats = ctx.stats; stats.threads = ctx.threads;
+	}
+
+	template<class BidirIt, class _Pred >
+	void parallel_sort(BidirIt _First, BidirIt _Last, _Pred compare)
+	{
+		sort_stats stats;
+		internal::parallel_sort(_First, _Last, compare, stats);
 	}
 }
 
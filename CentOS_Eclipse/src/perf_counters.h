@@ -0,0 +1,223 @@
+#ifndef PERF_COUNTERS_STL_H
+#define PERF_COUNTERS_STL_H
+
+namespace internal
+{
+	enum class sort_phase
+	{
+		// The checks if the array is already sorted and the pre-sorting passes
+		precheck,
+		// The partitioning of the array around the pivots
+		partition,
+		// The insertion sort of the small subarrays
+		leaf,
+		// The merging of the sorted runs
+		merge
+	};
+
+	// The number of phases the hardware events are attributed to
+	const std::size_t phase_count = 4;
+	// The number of hardware events counted per thread
+	const std::size_t perf_event_count = 5;
+
+	inline const std::vector<std::string>& phase_names()
+	{
+		static const std::vector<std::string> names = { "precheck", "partition", "leaf", "merge" };
+		return names;
+	}
+
+	inline const std::vector<std::string>& perf_event_names()
+	{
+		static const std::vector<std::string> names = { "cycles", \
+			"instructions", "branch-misses", "LLC-misses", "dTLB-misses" };
+		return names;
+	}
+
+	class perf_thread_counters
+	{
+	public:
+		perf_thread_counters() : leader(-1)
+		{
+			std::fill_n(fds, internal::perf_event_count, -1);
+			std::fill_n(ids, internal::perf_event_count, 0);
+
+		#if defined( __linux__ )
+			const std::uint32_t types[] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, \
+				PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE };
+			const std::uint64_t configs[] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, \
+				PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_CACHE_DTLB | \
+				(PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) };
+
+			// Open the events of the calling thread as a single group, so that all of them
+			// are read at once. The first event that can be opened becomes the group leader,
+			// and the events not supported by the processor or not permitted are left closed
+			for (std::size_t event = 0; event < internal::perf_event_count; event++)
+			{
+				perf_event_attr attr;
+				std::memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr); attr.type = types[event]; attr.config = configs[event];
+				attr.exclude_kernel = 1; attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | \
+					PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+				fds[event] = static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+				if (fds[event] < 0) continue;
+
+				if (::ioctl(fds[event], PERF_EVENT_IOC_ID, &ids[event]) < 0) {
+					::close(fds[event]); fds[event] = -1; continue;
+				}
+
+				if (leader < 0) leader = fds[event];
+			}
+		#endif
+		}
+
+		~perf_thread_counters()
+		{
+		#if defined( __linux__ )
+			// Close the group members ahead of the leader
+			for (std::size_t event = internal::perf_event_count; event > 0; event--)
+				if (fds[event - 1] >= 0) ::close(fds[event - 1]);
+		#endif
+		}
+
+		perf_thread_counters(const perf_thread_counters&) = delete;
+		perf_thread_counters& operator=(const perf_thread_counters&) = delete;
+
+	public:
+		bool read(std::uint64_t* values) const
+		{
+			if (leader < 0) return false;
+
+		#if defined( __linux__ )
+			// The group is read as { nr, time_enabled, time_running, { value, id } * nr }
+			std::uint64_t buffer[3 + 2 * internal::perf_event_count];
+			if (::read(leader, buffer, sizeof(buffer)) < ssize_t(3 * sizeof(std::uint64_t)))
+				return false;
+
+			// Scale the values up if the group has been multiplexed with other events
+			double scale = (buffer[2] > 0) ? (double)buffer[1] / buffer[2] : 1.0;
+			for (std::size_t event = 0; event < internal::perf_event_count; event++)
+			{
+				values[event] = 0;
+				for (std::uint64_t index = 0; index < buffer[0]; index++)
+					if (fds[event] >= 0 && buffer[4 + 2 * index] == ids[event])
+						values[event] = static_cast<std::uint64_t>(buffer[3 + 2 * index] * scale);
+			}
+
+			return true;
+		#else
+			return false;
+		#endif
+		}
+
+		bool available(std::size_t event) const { return fds[event] >= 0; }
+
+	public:
+		static const perf_thread_counters& current()
+		{
+			// Each worker opens its counters once, when it enters the first phase
+			static thread_local perf_thread_counters counters;
+			return counters;
+		}
+
+	protected:
+		int fds[internal::perf_event_count];
+		std::uint64_t ids[internal::perf_event_count];
+		int leader;
+	};
+
+	class perf_recorder
+	{
+	public:
+		perf_recorder() { this->reset(); }
+
+		perf_recorder(const perf_recorder&) = delete;
+		perf_recorder& operator=(const perf_recorder&) = delete;
+
+	public:
+		void reset()
+		{
+			for (std::size_t phase = 0; phase < internal::phase_count; phase++)
+			{
+				scopes[phase] = 0;
+				for (std::size_t event = 0; event < internal::perf_event_count; event++)
+					totals[phase][event] = 0;
+			}
+
+			for (std::size_t event = 0; event < internal::perf_event_count; event++)
+				opened[event] = false;
+		}
+
+		void add(sort_phase phase, const perf_thread_counters& counters, \
+			const std::uint64_t* start, const std::uint64_t* end)
+		{
+			// Accumulate the events counted by a worker within the phase
+			std::size_t index = static_cast<std::size_t>(phase);
+			for (std::size_t event = 0; event < internal::perf_event_count; event++)
+				if (counters.available(event))
+				{
+					totals[index][event].fetch_add((end[event] > start[event]) ? \
+						end[event] - start[event] : 0, std::memory_order_relaxed);
+					opened[event].store(true, std::memory_order_relaxed);
+				}
+
+			scopes[index].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		std::uint64_t value(sort_phase phase, std::size_t event) const {
+			return totals[static_cast<std::size_t>(phase)][event].load();
+		}
+
+		std::size_t count(sort_phase phase) const {
+			return scopes[static_cast<std::size_t>(phase)].load();
+		}
+
+		// Check if the event has been counted by at least one of the workers
+		bool available(std::size_t event) const { return opened[event].load(); }
+
+	protected:
+		std::atomic<std::uint64_t> totals[internal::phase_count][internal::perf_event_count];
+		std::atomic<std::size_t> scopes[internal::phase_count];
+		std::atomic<bool> opened[internal::perf_event_count];
+	};
+
+	class perf_scope
+	{
+	public:
+		perf_scope(perf_recorder* recorder, sort_phase phase)
+			: _recorder(recorder), _phase(phase)
+		{
+			// Don't count anything unless the caller has asked for the instrumentation
+			// and the counters of the current thread can be read
+			if (_recorder != NULL && !perf_thread_counters::current().read(start))
+				_recorder = NULL;
+		}
+
+		~perf_scope() { this->stop(); }
+
+		perf_scope(const perf_scope&) = delete;
+		perf_scope& operator=(const perf_scope&) = delete;
+
+	public:
+		void stop()
+		{
+			if (_recorder == NULL) return;
+
+			// Attribute the events counted since the start of the scope to its phase
+			std::uint64_t end[internal::perf_event_count];
+			const perf_thread_counters& counters = perf_thread_counters::current();
+			if (counters.read(end))
+				_recorder->add(_phase, counters, start, end);
+
+			_recorder = NULL;
+		}
+
+	protected:
+		perf_recorder* _recorder;
+		sort_phase _phase;
+		std::uint64_t start[internal::perf_event_count];
+	};
+}
+
+#endif // PERF_COUNTERS_STL_H
@@ -0,0 +1,123 @@
+#ifndef PROFILER_STL_H
+#define PROFILER_STL_H
+
+namespace internal
+{
+	// The number of data items sampled to estimate the number of distinct keys
+	const std::size_t profile_samples = 4096;
+
+	struct input_profile
+	{
+		// The number of data items profiled
+		std::size_t size;
+		// The number of adjacent pairs in the descending and in the ascending order
+		std::size_t descents, ascents;
+		// The number of the non-descending runs the array consists of
+		std::size_t runs;
+		// The minimum key and the range of keys, stored as the unsigned
+		// 64-bit values, and the number of bits of the range (integral keys only)
+		bool is_integral; std::uint64_t lo, range; int key_bits;
+		// The number of distinct keys estimated from the sample
+		std::size_t distinct;
+
+		bool is_sorted() const { return descents == 0; }
+		bool is_reversed() const { return ascents == 0 && descents > 0; }
+	};
+
+	template<class T>
+	std::uint64_t ordered_bits(const T& value, std::true_type)
+	{
+		// Map the integral key to the unsigned 64-bit value of the same order,
+		// flipping the sign bit of the signed keys extended to 64 bits
+		const std::uint64_t sign = std::is_signed<T>::value ? (std::uint64_t(1) << 63) : 0;
+		return static_cast<std::uint64_t>(value) ^ sign;
+	}
+
+	template<class T>
+	std::uint64_t ordered_bits(const T&, std::false_type)
+	{
+		// The keys of other types have no bounds
+		return 0;
+	}
+
+	template<class RanIt, class _Pred>
+	std::size_t estimate_distinct(RanIt _First, std::size_t* sample, std::size_t count, std::size_t size, _Pred compare)
+	{
+		if (count == 0) return 0;
+
+		// Count the distinct keys of the sample and those of them seen once and twice.
+		// The sample holds the positions of the data items rather than their copies
+		std::sort(sample, sample + count, [&](std::size_t first, std::size_t second) {
+			return compare(_First[first], _First[second]); });
+
+		std::size_t distinct = 0L, once = 0L, twice = 0L;
+		for (std::size_t index = 0; index < count; )
+		{
+			std::size_t next = index + 1;
+			while (next < count && !compare(_First[sample[index]], _First[sample[next]])) next++;
+			distinct++; once += (next - index == 1); twice += (next - index == 2);
+			index = next;
+		}
+
+		// Add the keys not sampled to those of the sample (the bias-corrected Chao1
+		// estimator): the more keys are seen only once rather than twice, the more
+		// keys the sample has likely missed
+		if (count >= size) return distinct;
+		double missed = (double)once * (once > 0 ? once - 1 : 0) / (2.0 * (twice + 1));
+		return static_cast<std::size_t>(std::min((double)size, distinct + missed));
+	}
+
+	template<class RanIt, class _Pred>
+	input_profile profile(RanIt _First, RanIt _Last, _Pred compare, int threads)
+	{
+		typedef typename std::iterator_traits<RanIt>::value_type T;
+		typedef std::integral_constant<bool, std::is_integral<T>::value && \
+			!std::is_same<T, bool>::value> is_integral;
+
+		input_profile profile = { 0L, 0L, 0L, 1L, false, 0L, 0L, 0, 0L };
+		profile.size = std::distance(_First, _Last);
+		if (profile.size == 0) return profile;
+
+		// Take the samples at the fixed stride, so that the estimate doesn't depend on the threads.
+		// The sample is kept on the stack, since the profile is taken by every sort
+		std::int64_t _Size = profile.size;
+		std::size_t stride = (profile.size + internal::profile_samples - 1) / internal::profile_samples;
+		std::size_t sample[internal::profile_samples], count = 0L;
+		for (std::size_t index = 0; index < profile.size; index += stride)
+			sample[count++] = index;
+
+		// Read each data item once, comparing it with its predecessor
+		// and widening the bounds of the integral keys at the same time
+		std::size_t descents = 0L, ascents = 0L;
+		std::uint64_t lo = std::numeric_limits<std::uint64_t>::max(), hi = 0;
+		#pragma omp parallel for num_threads(std::max(1, threads)) schedule(static) \
+			reduction(+:descents, ascents) reduction(min:lo) reduction(max:hi)
+		for (std::int64_t index = 0; index < _Size; index++)
+		{
+			if (index > 0)
+			{
+				if (compare(_First[index], _First[index - 1])) descents++;
+				else if (compare(_First[index - 1], _First[index])) ascents++;
+			}
+
+			std::uint64_t bits = internal::ordered_bits(_First[index], is_integral());
+			lo = std::min(lo, bits); hi = std::max(hi, bits);
+		}
+
+		profile.descents = descents; profile.ascents = ascents;
+		profile.runs = descents + 1;
+
+		// Restore the minimum key and compute the range in the unsigned arithmetic
+		profile.is_integral = is_integral::value;
+		const std::uint64_t sign = std::is_signed<T>::value ? (std::uint64_t(1) << 63) : 0;
+		profile.lo = profile.is_integral ? lo ^ sign : 0;
+		profile.range = profile.is_integral ? hi - lo : std::numeric_limits<std::uint64_t>::max();
+		for (profile.key_bits = 0; profile.key_bits < 64 && \
+			(profile.range >> profile.key_bits) != 0; profile.key_bits++);
+
+		profile.distinct = internal::estimate_distinct(_First, sample, count, profile.size, compare);
+		return profile;
+	}
+}
+
+#endif // PROFILER_STL_H
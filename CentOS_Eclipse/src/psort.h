@@ -0,0 +1,337 @@
+#include "co_sort.h"
+#include "sort_unique.h"
+#include "async_sort.h"
+#include "stream_sort.h"
+#include "segmented_sort.h"
+#include "execution.h"
+#include "gensort.h"
+
+#ifndef PSORT_STL_H
+#define PSORT_STL_H
+
+namespace psort
+{
+	// The statistics reported by a single call to the sorter
+	typedef internal::sort_stats sort_stats;
+	// The bounded pool of workers shared by concurrent callers
+	typedef internal::thread_pool thread_pool;
+	// The handle of a sort running in the background
+	typedef internal::sort_handle sort_handle;
+	// The sorter of a stream of chunks, sorted in the background as they arrive
+	template<class T, class _Pred = std::less<T>>
+	using stream_sorter = internal::stream_sorter<T, _Pred>;
+	// The source of the scratch memory used by the sorter
+	typedef internal::memory_resource memory_resource;
+	// The scratch memory reused by the repeated calls without returning it to the heap
+	typedef internal::scratch_arena scratch_arena;
+	// The partitioning scheme of the quicksort backend
+	typedef internal::sort_engine sort_engine;
+	// The hardware counters of the workers attributed to the phases of the sort
+	typedef internal::perf_recorder perf_recorder;
+	// The timeline of the tasks performing the sort, exported in the Chrome trace format
+	typedef internal::sort_tracer sort_tracer;
+	// The (offset, length) of a run of the items with equal keys in the sorted array
+	typedef internal::key_group key_group;
+	// The projection that yields the data item itself
+	typedef internal::identity identity;
+	// The 100-byte record of the sort benchmark with the 10-byte key
+	typedef internal::gensort_record gensort_record;
+	// The order, the duplicate keys and the checksum of an array of records
+	typedef internal::record_summary record_summary;
+
+	namespace execution
+	{
+		// The execution policies of the sort, selecting the threads performing it
+		// for each call: par(4) limits the sort to 4 threads, par.on(pool) draws
+		// the threads from the given pool rather than from the shared one
+		typedef internal::execution_policy<internal::policy_kind::sequenced> sequenced_policy;
+		typedef internal::execution_policy<internal::policy_kind::parallel> parallel_policy;
+		typedef internal::execution_policy<internal::policy_kind::parallel_unsequenced> parallel_unsequenced_policy;
+		typedef internal::execution_policy<internal::policy_kind::stable> stable_policy;
+
+		const sequenced_policy seq = { 1, NULL };
+		const parallel_policy par = { 0, NULL };
+		const parallel_unsequenced_policy par_unseq = { 0, NULL };
+		const stable_policy stable = { 0, NULL };
+	}
+
+	template<class Policy>
+	using is_execution_policy = internal::is_execution_policy<typename std::decay<Policy>::type>;
+
+	// The functions of this namespace are reentrant: they keep no mutable global
+	// state, and all concurrent calls draw their workers from the same bounded pool
+
+	inline void init()
+	{
+		// Load the tuning profile and start the workers at startup rather than within the first sort
+		internal::initialize();
+	}
+
+	template<class RanIt, class _Pred>
+	void sort(RanIt _First, RanIt _Last, _Pred compare, \
+		sort_stats& stats, thread_pool& pool, memory_resource& scratch)
+	{
+		// Draw all scratch buffers of the call from the given resource
+		internal::parallel_sort(_First, _Last, compare, stats, pool, NULL, &scratch);
+	}
+
+	template<class RanIt, class _Pred>
+	void sort(RanIt _First, RanIt _Last, _Pred compare, \
+		sort_stats& stats, thread_pool& pool)
+	{
+		internal::parallel_sort(_First, _Last, compare, stats, pool);
+	}
+
+	template<class RanIt, class _Pred>
+	void sort(RanIt _First, RanIt _Last, _Pred compare, sort_engine engine, \
+		sort_stats& stats, thread_pool& pool = thread_pool::shared())
+	{
+		// Sort by using the selected quicksort backend rather than the default one
+		internal::parallel_sort(_First, _Last, compare, stats, pool, NULL, NULL, engine);
+	}
+
+	template<class RanIt, class _Pred>
+	void sort(RanIt _First, RanIt _Last, _Pred compare, sort_stats& stats)
+	{
+		internal::parallel_sort(_First, _Last, compare, stats, thread_pool::shared());
+	}
+
+	template<class RanIt, class _Pred>
+	void sort(RanIt _First, RanIt _Last, _Pred compare)
+	{
+		sort_stats stats;
+		psort::sort(_First, _Last, compare, stats);
+	}
+
+	template<class Policy, class RanIt, class _Pred, \
+		class = typename std::enable_if<is_execution_policy<Policy>::value>::type>
+	void sort(const Policy& policy, RanIt _First, RanIt _Last, _Pred compare, sort_stats& stats)
+	{
+		// Sort by the threads the policy selects, as a drop-in replacement for std::sort
+		internal::policy_sort(policy, _First, _Last, compare, stats);
+	}
+
+	template<class Policy, class RanIt, class _Pred, \
+		class = typename std::enable_if<is_execution_policy<Policy>::value>::type>
+	void sort(const Policy& policy, RanIt _First, RanIt _Last, _Pred compare)
+	{
+		sort_stats stats;
+		internal::policy_sort(policy, _First, _Last, compare, stats);
+	}
+
+	template<class Policy, class RanIt, \
+		class = typename std::enable_if<is_execution_policy<Policy>::value>::type>
+	void sort(const Policy& policy, RanIt _First, RanIt _Last)
+	{
+		// Sort in the ascending order of the data items
+		sort_stats stats;
+		internal::policy_sort(policy, _First, _Last, std::less<>(), stats);
+	}
+
+	template<class Policy, class Range, class _Pred = std::less<>, class Proj = identity, \
+		class = typename std::enable_if<is_execution_policy<Policy>::value>::type, \
+		class = decltype(std::begin(std::declval<Range&>()))>
+	void sort(const Policy& policy, Range&& range, _Pred compare = _Pred(), Proj proj = Proj())
+	{
+		// Sort the whole range, comparing the keys the projection yields for the data items
+		sort_stats stats;
+		internal::projected_compare<_Pred, Proj> projected = { compare, proj };
+		internal::policy_sort(policy, std::begin(range), std::end(range), projected, stats);
+	}
+
+	template<class RanIt, class _Pred>
+	sort_handle sort_async(RanIt _First, RanIt _Last, _Pred compare, \
+		std::function<void(bool)> callback = std::function<void(bool)>(), \
+		thread_pool& pool = thread_pool::shared())
+	{
+		// Start the sort on a host thread of the pool and return immediately; the handle
+		// reports the progress, accepts the cancellation and yields the result. The pool
+		// waits for the sort when destroyed, the array must stay valid until it is done
+		return internal::sort_async(_First, _Last, compare, callback, pool);
+	}
+
+	template<class RanIt, class OffsetIt, class _Pred>
+	void sort_segments(RanIt _First, OffsetIt _OffFirst, OffsetIt _OffLast, _Pred compare, \
+		sort_stats& stats, thread_pool& pool, memory_resource& scratch)
+	{
+		// Build the list of segments within the given resource rather than on the heap
+		internal::segmented_sort(_First, _OffFirst, _OffLast, compare, stats, pool, &scratch);
+	}
+
+	template<class RanIt, class OffsetIt, class _Pred>
+	void sort_segments(RanIt _First, OffsetIt _OffFirst, OffsetIt _OffLast, \
+		_Pred compare, sort_stats& stats, thread_pool& pool)
+	{
+		// Sort each segment [_First + offset[i], _First + offset[i + 1]) of the flat buffer
+		internal::segmented_sort(_First, _OffFirst, _OffLast, compare, stats, pool);
+	}
+
+	template<class RanIt, class OffsetIt, class _Pred>
+	void sort_segments(RanIt _First, OffsetIt _OffFirst, OffsetIt _OffLast, _Pred compare)
+	{
+		sort_stats stats;
+		internal::segmented_sort(_First, _OffFirst, _OffLast, compare, stats);
+	}
+
+	template<class Ranges, class _Pred>
+	void sort_segments(Ranges& ranges, _Pred compare, sort_stats& stats, \
+		thread_pool& pool, memory_resource& scratch)
+	{
+		internal::segmented_sort(ranges, compare, stats, pool, &scratch);
+	}
+
+	template<class Ranges, class _Pred>
+	void sort_segments(Ranges& ranges, _Pred compare, sort_stats& stats, thread_pool& pool)
+	{
+		// Sort each range of the range of ranges
+		internal::segmented_sort(ranges, compare, stats, pool);
+	}
+
+	template<class Ranges, class _Pred>
+	void sort_segments(Ranges& ranges, _Pred compare)
+	{
+		sort_stats stats;
+		internal::segmented_sort(ranges, compare, stats);
+	}
+
+	template<class RanIt, class _Pred>
+	RanIt sort_unique(RanIt _First, RanIt _Last, _Pred compare, \
+		sort_stats& stats, thread_pool& pool = thread_pool::shared())
+	{
+		// Sort the array and keep one item of each run of equal items at its beginning;
+		// returns the end of the distinct items, the rest of the array is left moved-from
+		return internal::parallel_sort_unique(_First, _Last, compare, stats, pool);
+	}
+
+	template<class RanIt, class _Pred>
+	RanIt sort_unique(RanIt _First, RanIt _Last, _Pred compare)
+	{
+		sort_stats stats;
+		return psort::sort_unique(_First, _Last, compare, stats);
+	}
+
+	template<class RanIt, class _Pred>
+	std::size_t count_distinct(RanIt _First, RanIt _Last, _Pred compare, \
+		sort_stats& stats, thread_pool& pool = thread_pool::shared())
+	{
+		// Sort the array and count the distinct items in it
+		return internal::parallel_count_distinct(_First, _Last, compare, stats, pool);
+	}
+
+	template<class RanIt, class _Pred>
+	std::size_t count_distinct(RanIt _First, RanIt _Last, _Pred compare)
+	{
+		sort_stats stats;
+		return psort::count_distinct(_First, _Last, compare, stats);
+	}
+
+	template<class RanIt, class _Pred>
+	std::vector<key_group> sort_groups(RanIt _First, RanIt _Last, _Pred compare, \
+		sort_stats& stats, thread_pool& pool = thread_pool::shared())
+	{
+		// Sort the array and return the groups of equal keys in it, taken from the
+		// partitions of the sort and completed by a scan of the rest of the array
+		internal::key_groups groups;
+		internal::parallel_sort(_First, _Last, compare, stats, pool, \
+			NULL, NULL, internal::sort_engine::three_way, NULL, NULL, NULL, &groups);
+		return std::move(groups.groups);
+	}
+
+	template<class RanIt, class _Pred>
+	std::vector<key_group> sort_groups(RanIt _First, RanIt _Last, _Pred compare)
+	{
+		sort_stats stats;
+		return psort::sort_groups(_First, _Last, compare, stats);
+	}
+
+	template<class RanIt1, class RanIt2, class OutIt, class _Pred>
+	OutIt merge(RanIt1 _First1, RanIt1 _Last1, RanIt2 _First2, RanIt2 _Last2, \
+		OutIt _Dest, _Pred compare, thread_pool& pool = thread_pool::shared())
+	{
+		// Merge two sorted arrays, splitting the merge path into equal shares of the threads,
+		// or sequentially if the destination is an output iterator that is not random-access
+		return internal::merge_into(_First1, _Last1, _First2, _Last2, _Dest, compare, \
+			pool, internal::is_random_output<OutIt>());
+	}
+
+	template<class RanIt, class _Pred>
+	void inplace_merge(RanIt _First, RanIt _Middle, RanIt _Last, \
+		_Pred compare, thread_pool& pool = thread_pool::shared())
+	{
+		// Merge the consecutive sorted runs [_First, _Middle) and [_Middle, _Last)
+		internal::parallel_inplace_merge(_First, _Middle, _Last, compare, pool);
+	}
+
+	template<class RanIt1, class RanIt2, class OutIt, class _Pred>
+	OutIt set_union(RanIt1 _First1, RanIt1 _Last1, RanIt2 _First2, RanIt2 _Last2, \
+		OutIt _Dest, _Pred compare, thread_pool& pool = thread_pool::shared())
+	{
+		// The operations on the sorted arrays follow the semantics of their counterparts
+		// of the standard library, including the multiplicity of the equal items; they
+		// run sequentially if the destination is an output iterator that is not random-access
+		return internal::parallel_set_union(_First1, _Last1, _First2, _Last2, _Dest, compare, pool);
+	}
+
+	template<class RanIt1, class RanIt2, class OutIt, class _Pred>
+	OutIt set_intersection(RanIt1 _First1, RanIt1 _Last1, RanIt2 _First2, RanIt2 _Last2, \
+		OutIt _Dest, _Pred compare, thread_pool& pool = thread_pool::shared())
+	{
+		return internal::parallel_set_intersection(_First1, _Last1, _First2, _Last2, _Dest, compare, pool);
+	}
+
+	template<class RanIt1, class RanIt2, class OutIt, class _Pred>
+	OutIt set_difference(RanIt1 _First1, RanIt1 _Last1, RanIt2 _First2, RanIt2 _Last2, \
+		OutIt _Dest, _Pred compare, thread_pool& pool = thread_pool::shared())
+	{
+		return internal::parallel_set_difference(_First1, _Last1, _First2, _Last2, _Dest, compare, pool);
+	}
+
+	template<class RanIt, class OutIt>
+	void sort_records(RanIt _First, RanIt _Last, OutIt _Dest, \
+		sort_stats& stats, thread_pool& pool = thread_pool::shared())
+	{
+		// Sort the records by their 10-byte keys into the destination, moving
+		// the cached key prefixes while sorting rather than the whole records
+		internal::sort_records(_First, _Last, _Dest, stats, pool);
+	}
+
+	template<class RanIt>
+	void sort_records(RanIt _First, RanIt _Last)
+	{
+		sort_stats stats;
+		internal::sort_records(_First, _Last, stats);
+	}
+
+	template<class RanIt>
+	record_summary validate_records(RanIt _First, RanIt _Last)
+	{
+		// Check the order of the records and compute their checksum as valsort does
+		return internal::validate_records(_First, _Last);
+	}
+
+	template<class RanIt, class _Pred, class... Columns>
+	void sort_columns(RanIt _First, RanIt _Last, _Pred compare, Columns&... columns)
+	{
+		// Sort the key column and reorder each payload column consistently with it
+		sort_stats stats;
+		internal::co_sort(_First, _Last, compare, stats, thread_pool::shared(), columns...);
+	}
+
+	template<class RanIt, class _Pred>
+	std::vector<std::size_t> sort_permutation(RanIt _First, RanIt _Last, _Pred compare)
+	{
+		// Sort the key column and return the original position of each sorted key
+		sort_stats stats; std::vector<std::size_t> perm;
+		internal::sort_permutation(_First, _Last, compare, perm, stats);
+		return perm;
+	}
+
+	template<class Index, class... Columns>
+	void apply_permutation(const std::vector<Index>& perm, Columns&... columns)
+	{
+		// Reorder the columns, so that the row i takes the row perm[i] of the original
+		internal::apply_permutation(perm, thread_pool::shared(), columns...);
+	}
+}
+
+#endif // PSORT_STL_H
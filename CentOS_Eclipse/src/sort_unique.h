@@ -0,0 +1,100 @@
+#include "parallel_sort.h"
+
+#ifndef SORT_UNIQUE_STL_H
+#define SORT_UNIQUE_STL_H
+
+namespace internal
+{
+	template<class RanIt, class _Pred>
+	std::size_t count_heads(RanIt _First, RanIt _Begin, RanIt _End, _Pred compare)
+	{
+		// Count the items of the sorted chunk [_Begin, _End) that are greater than their
+		// predecessors, i.e. the first items of the runs of equal items
+		std::size_t count = 0L;
+		for (RanIt _It = _Begin; _It != _End; _It++)
+			if (_It == _First || compare(*(_It - 1), *_It)) count++;
+
+		return count;
+	}
+
+	template<class RanIt, class _Pred>
+	std::size_t parallel_count_distinct(RanIt _First, RanIt _Last, _Pred compare, \
+		sort_stats& stats, thread_pool& pool = thread_pool::shared())
+	{
+		internal::parallel_sort(_First, _Last, compare, stats, pool);
+
+		// Count the first items of the runs of equal items in parallel
+		std::int64_t _Size = std::distance(_First, _Last);
+		std::size_t count = 0L;
+
+		pool_lease lease(pool, omp_get_max_threads());
+		#pragma omp parallel for num_threads(lease.size()) schedule(static) reduction(+:count)
+		for (std::int64_t index = 0; index < _Size; index++)
+			if (index == 0 || compare(_First[index - 1], _First[index])) count++;
+
+		return count;
+	}
+
+	template<class RanIt, class _Pred>
+	RanIt parallel_sort_unique(RanIt _First, RanIt _Last, _Pred compare, sort_stats& stats, \
+		thread_pool& pool = thread_pool::shared(), memory_resource* scratch = NULL)
+	{
+		typedef typename std::iterator_traits<RanIt>::value_type T;
+
+		internal::parallel_sort(_First, _Last, compare, stats, pool, NULL, scratch);
+
+		std::size_t _Size = std::distance(_First, _Last);
+		if (_Size < 2) return _Last;
+
+		pool_lease lease(pool, omp_get_max_threads());
+		memory_resource* resource = (scratch != NULL) ? scratch : internal::huge_page_memory();
+
+		// The offsets of the distinct items of each chunk in the result, and whether
+		// the first item of each chunk differs from the last item of the previous one
+		std::vector<std::size_t, arena_allocator<std::size_t>> \
+			offsets(lease.size() + 1, 0, arena_allocator<std::size_t>(resource));
+		std::vector<char, arena_allocator<char>> \
+			is_head(lease.size(), 0, arena_allocator<char>(resource));
+		std::vector<T, arena_allocator<T>> buffer((arena_allocator<T>(resource)));
+		int team = 1;
+
+		#pragma omp parallel num_threads(lease.size()) shared(offsets, is_head, buffer, team)
+		{
+			int tid = omp_get_thread_num(), threads = omp_get_num_threads();
+			std::size_t begin = _Size * tid / threads, end = _Size * (tid + 1) / threads;
+
+			// Count the distinct items of the chunk while no item has been moved yet
+			is_head[tid] = (begin == 0 || compare(_First[begin - 1], _First[begin]));
+			offsets[tid + 1] = internal::count_heads(_First, _First + begin, _First + end, compare);
+
+			#pragma omp barrier
+			#pragma omp single
+			{
+				// Turn the counts into the offsets by the prefix sum
+				for (int index = 0; index < threads; index++)
+					offsets[index + 1] += offsets[index];
+
+				buffer.resize(offsets[threads]); team = threads;
+			}
+
+			// Move the first item of each run into the buffer. Since the items moved
+			// by the thread are no longer valid, each item is compared with the last
+			// item moved into the buffer rather than with its predecessor
+			std::size_t out = offsets[tid];
+			for (std::size_t index = begin; index < end; index++)
+			{
+				bool is_first = (out == offsets[tid]) ? ((index == begin) ? is_head[tid] != 0 : \
+					compare(_First[index - 1], _First[index])) : compare(buffer[out - 1], _First[index]);
+				if (is_first) buffer[out++] = std::move(_First[index]);
+			}
+
+			// Move the distinct items back to the beginning of the array
+			#pragma omp barrier
+			std::move(buffer.begin() + offsets[tid], buffer.begin() + offsets[tid + 1], _First + offsets[tid]);
+		}
+
+		return _First + offsets[team];
+	}
+}
+
+#endif // SORT_UNIQUE_STL_H
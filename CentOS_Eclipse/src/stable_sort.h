@@ -0,0 +1,98 @@
+#include "merge.h"
+
+#ifndef STABLE_SORT_STL_H
+#define STABLE_SORT_STL_H
+
+namespace internal
+{
+	template<class RanIt, class OutIt, class _Pred>
+	void merge_runs(RanIt _First, OutIt _Dest, const std::vector<std::size_t>& bounds, \
+		std::vector<std::size_t>& merged, _Pred compare, sort_context& ctx)
+	{
+		// Merge each pair of the adjacent runs into the destination, moving the odd run
+		// as is. The merge places the items of the left run ahead of the equal items of
+		// the right one, so that the equal items retain their original order
+		merged.clear(); merged.push_back(bounds.front());
+		for (std::size_t run = 0; run + 1 < bounds.size(); run += 2)
+		{
+			std::size_t first = bounds[run], middle = bounds[run + 1];
+			std::size_t last = (run + 2 < bounds.size()) ? bounds[run + 2] : middle;
+
+			internal::parallel_merge(std::make_move_iterator(_First + first), \
+				std::make_move_iterator(_First + middle), std::make_move_iterator(_First + middle), \
+				std::make_move_iterator(_First + last), _Dest + first, compare, ctx);
+			merged.push_back(last);
+		}
+	}
+
+	template<class RanIt, class _Pred>
+	void parallel_stable_sort(RanIt _First, RanIt _Last, _Pred compare, sort_stats& stats, \
+		thread_pool& pool = thread_pool::shared(), memory_resource* scratch = NULL)
+	{
+		typedef typename std::iterator_traits<RanIt>::value_type T;
+
+		std::size_t _Size = std::distance(_First, _Last);
+		sort_tuning cutoffs = internal::tuning_for(_First);
+		pool_lease lease(pool, (_Size < cutoffs.parallel) ? 1 : omp_get_max_threads());
+		sort_context ctx = { lease.size(), sort_stats(), NULL, scratch, \
+			sort_engine::three_way, cutoffs, 0L, 0L, NULL, NULL, NULL };
+		internal::dispatch(ctx, "merge_sort", "stable order requested");
+
+		// Sort the small arrays by a single thread
+		if (ctx.threads <= 1 || _Size < cutoffs.parallel)
+		{
+			std::stable_sort(_First, _Last, compare);
+			stats = ctx.stats; stats.threads = 1;
+			return;
+		}
+
+		// Split the array into the equal runs, one per thread, and sort each
+		// of them by the stable sort of the standard library
+		std::int64_t runs = ctx.threads;
+		std::vector<std::size_t> bounds(runs + 1);
+		for (std::int64_t run = 0; run <= runs; run++)
+			bounds[run] = _Size * run / runs;
+
+		#pragma omp parallel for num_threads(ctx.threads) schedule(static)
+		for (std::int64_t run = 0; run < runs; run++)
+		{
+			internal::trace_scope trace(ctx.tracer, "run", sort_phase::leaf, bounds[run + 1] - bounds[run], 0);
+			std::stable_sort(_First + bounds[run], _First + bounds[run + 1], compare);
+		}
+
+		// Merge the runs pairwise, bouncing the data between the array and the
+		// scratch buffer, until a single run is left
+		std::vector<T, arena_allocator<T>> buffer(_Size, arena_allocator<T>(internal::scratch(ctx)));
+		std::vector<std::size_t> merged;
+		bool in_buffer = false;
+		while (bounds.size() > 2)
+		{
+			if (in_buffer)
+				internal::merge_runs(buffer.begin(), _First, bounds, merged, compare, ctx);
+			else internal::merge_runs(_First, buffer.begin(), bounds, merged, compare, ctx);
+
+			bounds.swap(merged); in_buffer = !in_buffer;
+			ctx.stats.depth++;
+		}
+
+		// Move the result back into place if the last pass has left it in the buffer
+		if (in_buffer)
+		{
+			std::int64_t count = _Size;
+			#pragma omp parallel for num_threads(ctx.threads) schedule(static)
+			for (std::int64_t index = 0; index < count; index++)
+				_First[index] = std::move(buffer[index]);
+		}
+
+		stats = ctx.stats; stats.threads = ctx.threads;
+	}
+
+	template<class RanIt, class _Pred>
+	void parallel_stable_sort(RanIt _First, RanIt _Last, _Pred compare)
+	{
+		sort_stats stats;
+		internal::parallel_stable_sort(_First, _Last, compare, stats);
+	}
+}
+
+#endif // STABLE_SORT_STL_H
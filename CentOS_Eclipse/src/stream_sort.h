@@ -0,0 +1,189 @@
+#include "merge.h"
+
+#ifndef STREAM_SORT_STL_H
+#define STREAM_SORT_STL_H
+
+namespace internal
+{
+	template<class T, class _Pred>
+	class stream_sorter
+	{
+	public:
+		explicit stream_sorter(_Pred compare = _Pred(), thread_pool& pool = thread_pool::shared())
+			: _compare(compare), _pool(pool), busy(false), stopping(false),
+			  worker(&stream_sorter::run, this) { }
+
+		~stream_sorter()
+		{
+			// Drop the chunks still queued, so that an unfinished sorter is destroyed
+			// without sorting them, and stop the worker once its current chunk is done
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				chunks.clear(); stopping = true;
+			}
+
+			ready.notify_one(); worker.join();
+		}
+
+		stream_sorter(const stream_sorter&) = delete;
+		stream_sorter& operator=(const stream_sorter&) = delete;
+
+	public:
+		template<class InputIt>
+		void push(InputIt _First, InputIt _Last) {
+			this->push(std::vector<T>(_First, _Last));
+		}
+
+		void push(std::vector<T>&& chunk)
+		{
+			if (chunk.empty()) return;
+
+			// Queue the chunk for the background worker, which sorts the chunks one at
+			// a time by the threads of the pool, so that no more threads are started
+			// than the pool allows, however fast the chunks arrive
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				chunks.push_back(std::move(chunk));
+			}
+
+			ready.notify_one();
+		}
+
+		std::vector<T> finish()
+		{
+			// Wait for all chunks to be sorted and merged into the tiers
+			this->wait();
+
+			// Collect the remaining runs, at most one per tier, and merge them
+			// from the smallest to the largest, so that only the last merge is big
+			std::vector<T> result;
+			for (std::size_t level = 0; level < tiers.size(); level++)
+			{
+				if (tiers[level].empty()) continue;
+				if (result.empty()) {
+					result = std::move(tiers[level]); continue;
+				}
+
+				result = this->merge(tiers[level], result);
+			}
+
+			tiers.clear();
+			return result;
+		}
+
+	protected:
+		void run()
+		{
+			for (;;)
+			{
+				std::vector<T> chunk;
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					ready.wait(guard, [this]() { return stopping || !chunks.empty(); });
+					if (chunks.empty()) return;
+
+					chunk = std::move(chunks.front());
+					chunks.pop_front(); busy = true;
+				}
+
+				// Keep the first failure to rethrow it to the caller of finish
+				try
+				{
+					sort_stats stats;
+					internal::parallel_sort(chunk.begin(), chunk.end(), _compare, stats, _pool);
+					this->insert(std::move(chunk), 0);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					if (!error) error = std::current_exception();
+				}
+
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					busy = false;
+				}
+
+				idle.notify_all();
+			}
+		}
+
+		void wait()
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			idle.wait(guard, [this]() { return chunks.empty() && !busy; });
+
+			if (error)
+			{
+				std::exception_ptr failure = error;
+				error = std::exception_ptr();
+				std::rethrow_exception(failure);
+			}
+		}
+
+		std::vector<T> merge(std::vector<T>& first, std::vector<T>& second) {
+			return this->merge(first, second, std::is_default_constructible<T>());
+		}
+
+		std::vector<T> merge(std::vector<T>& first, std::vector<T>& second, std::true_type)
+		{
+			// Move the data items of both runs into the merged run rather than copy them
+			std::vector<T> merged(first.size() + second.size());
+			internal::parallel_merge(std::make_move_iterator(first.begin()), \
+				std::make_move_iterator(first.end()), std::make_move_iterator(second.begin()), \
+				std::make_move_iterator(second.end()), merged.begin(), _compare, _pool);
+			return merged;
+		}
+
+		std::vector<T> merge(std::vector<T>& first, std::vector<T>& second, std::false_type)
+		{
+			// The data items can't be default-constructed in place, so merge them into
+			// the uninitialized storage, constructing each item there, and then move
+			// them into the merged run
+			std::size_t size = first.size() + second.size();
+			std::allocator<T> allocator;
+			T* storage = allocator.allocate(size);
+			internal::parallel_merge(std::make_move_iterator(first.begin()), \
+				std::make_move_iterator(first.end()), std::make_move_iterator(second.begin()), \
+				std::make_move_iterator(second.end()), construct_iterator<T>(storage), _compare, _pool);
+
+			std::vector<T> merged;
+			merged.reserve(size);
+			merged.insert(merged.end(), std::make_move_iterator(storage), std::make_move_iterator(storage + size));
+
+			for (std::size_t index = 0; index < size; index++)
+				storage[index].~T();
+			allocator.deallocate(storage, size);
+			return merged;
+		}
+
+		void insert(std::vector<T>&& run, std::size_t level)
+		{
+			// Place the run into the tier of the given level. If the tier already
+			// holds a run, merge both runs into the next tier, so that each item
+			// is merged only a logarithmic number of times. The tiers are only
+			// touched by the worker, until finish has waited for it to be idle
+			for (; level < tiers.size() && !tiers[level].empty(); level++)
+			{
+				run = this->merge(tiers[level], run);
+				tiers[level].clear();
+			}
+
+			if (tiers.size() <= level) tiers.resize(level + 1);
+			tiers[level] = std::move(run);
+		}
+
+	protected:
+		_Pred _compare;
+		thread_pool& _pool;
+		std::mutex lock;
+		std::condition_variable ready, idle;
+		std::deque<std::vector<T>> chunks;
+		std::exception_ptr error;
+		bool busy, stopping;
+		std::vector<std::vector<T>> tiers;
+		std::thread worker;
+	};
+}
+
+#endif // STREAM_SORT_STL_H
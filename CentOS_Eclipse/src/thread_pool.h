@@ -0,0 +1,137 @@
+#ifndef THREAD_POOL_STL_H
+#define THREAD_POOL_STL_H
+
+namespace internal
+{
+	class thread_pool
+	{
+	public:
+		explicit thread_pool(int size = omp_get_num_procs())
+			: _size(std::max(1, size)), available(std::max(1, size)), active(0), next_ticket(0), serving(0),
+			  idle(0), stopping(false) { }
+
+		~thread_pool()
+		{
+			// Let the hosts run the jobs already submitted, so that none of them
+			// outlives the pool it draws its workers from, then join them
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stopping = true;
+			}
+
+			submitted.notify_all();
+			for (std::thread& host : hosts) host.join();
+		}
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+	public:
+		int acquire(int wanted)
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			// Take a ticket and wait until all callers that have come earlier
+			// are served and at least one worker of the pool is available
+			std::size_t ticket = next_ticket++;
+			ready.wait(guard, [this, ticket] { return serving == ticket && available > 0; });
+
+			// Grant a fair share of the pool with respect to the number
+			// of callers that are either running or waiting for workers
+			int callers = active + static_cast<int>(next_ticket - serving);
+			int granted = std::min(std::min(std::max(1, wanted), available), \
+				std::max(1, _size / callers));
+
+			available -= granted; active++; serving++;
+			ready.notify_all();
+
+			return granted;
+		}
+
+		void release(int count)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			// Return the workers to the pool and wake up the waiting callers
+			available += count; active--;
+			ready.notify_all();
+		}
+
+		void submit(std::function<void()> job)
+		{
+			// Queue the job for a host thread of the pool, starting another host
+			// while all of them are busy, but never more hosts than the pool size
+			std::lock_guard<std::mutex> guard(lock);
+			jobs.push_back(std::move(job));
+			if (idle == 0 && hosts.size() < static_cast<std::size_t>(_size))
+				hosts.push_back(std::thread(&thread_pool::host, this));
+			else submitted.notify_one();
+		}
+
+	public:
+		int size() const { return _size; }
+
+		// The process-wide pool shared by all callers that don't provide their own
+		static thread_pool& shared() {
+			static thread_pool pool; return pool;
+		}
+
+	protected:
+		void host()
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			for (;;)
+			{
+				idle++;
+				submitted.wait(guard, [this] { return stopping || !jobs.empty(); });
+				idle--;
+				if (jobs.empty()) return;
+
+				std::function<void()> job = std::move(jobs.front());
+				jobs.pop_front();
+
+				guard.unlock(); job(); guard.lock();
+			}
+		}
+
+	protected:
+		const int _size;
+		int available, active;
+		std::size_t next_ticket, serving;
+		std::mutex lock;
+		std::condition_variable ready;
+
+		// The threads hosting the submitted jobs and the jobs waiting for them
+		std::vector<std::thread> hosts;
+		std::deque<std::function<void()>> jobs;
+		int idle; bool stopping;
+		std::condition_variable submitted;
+	};
+
+	struct pool_lease
+	{
+	public:
+		pool_lease(thread_pool& pool, int wanted)
+			: _pool(pool), count(0)
+		{
+			// Callers that already run inside of a parallel region keep
+			// their own thread and don't draw the workers from the pool
+			if (!omp_in_parallel())
+				count = pool.acquire(wanted);
+		}
+
+		~pool_lease() {
+			if (count > 0) _pool.release(count);
+		}
+
+		pool_lease(const pool_lease&) = delete;
+		pool_lease& operator=(const pool_lease&) = delete;
+
+	public:
+		int size() const { return std::max(1, count); }
+
+	protected:
+		thread_pool& _pool;
+		int count;
+	};
+}
+
+#endif // THREAD_POOL_STL_H
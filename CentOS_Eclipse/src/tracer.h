@@ -0,0 +1,186 @@
+#include "perf_counters.h"
+
+#ifndef TRACER_STL_H
+#define TRACER_STL_H
+
+namespace internal
+{
+	// The number of events each thread keeps before the oldest ones are overwritten
+	const std::size_t trace_capacity = 65536;
+
+	struct trace_event
+	{
+		// The name of the task and the phase of the sort it belongs to
+		const char* name; sort_phase phase;
+		// The size of the subrange and the depth of the task in the recursion
+		std::size_t size; int depth;
+		// The time (in nanoseconds since the tracer has been created) the task began and ended
+		std::uint64_t begin, end;
+	};
+
+	class trace_ring
+	{
+	public:
+		explicit trace_ring(std::size_t capacity) : events(capacity), head(0) { }
+
+	public:
+		void push(const trace_event& event)
+		{
+			// Only the owning thread writes to the ring, so the slot is written
+			// without a lock and published by advancing the head afterwards
+			std::size_t index = head.load(std::memory_order_relaxed);
+			events[index % events.size()] = event;
+			head.store(index + 1, std::memory_order_release);
+		}
+
+		// The number of events the ring holds and the number of the overwritten ones
+		std::size_t size() const { return std::min(head.load(std::memory_order_acquire), events.size()); }
+		std::size_t dropped() const { return head.load(std::memory_order_acquire) - this->size(); }
+
+		const trace_event& operator[](std::size_t index) const
+		{
+			// Index the events from the oldest to the latest one
+			std::size_t first = head.load(std::memory_order_acquire) - this->size();
+			return events[(first + index) % events.size()];
+		}
+
+	protected:
+		std::vector<trace_event> events;
+		std::atomic<std::size_t> head;
+	};
+
+	class sort_tracer
+	{
+	public:
+		explicit sort_tracer(std::size_t capacity = internal::trace_capacity, \
+			int threads = 4 * std::max(omp_get_num_procs(), omp_get_max_threads()))
+			: _capacity(capacity), rings(threads), next(0), lost(0), \
+			  id(sort_tracer::serial()++), origin(std::chrono::steady_clock::now()) { }
+
+		sort_tracer(const sort_tracer&) = delete;
+		sort_tracer& operator=(const sort_tracer&) = delete;
+
+	public:
+		void record(const char* name, sort_phase phase, std::size_t size, int depth, \
+			std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+		{
+			trace_ring* ring = this->ring();
+			if (ring == NULL) {
+				lost.fetch_add(1, std::memory_order_relaxed); return;
+			}
+
+			trace_event event = { name, phase, size, depth, \
+				this->elapsed(begin), this->elapsed(end) };
+			ring->push(event);
+		}
+
+		// The number of events lost because the rings have been overwritten or exhausted
+		std::size_t dropped() const
+		{
+			std::size_t count = lost.load();
+			for (std::size_t index = 0; index < this->threads(); index++)
+				count += rings[index]->dropped();
+			return count;
+		}
+
+		bool save(const std::string& filename) const
+		{
+			std::ofstream file(filename);
+			if (!file.is_open()) return false;
+
+			// Write the events in the Chrome trace-event format, one timeline per thread,
+			// as the complete events with the timestamps and durations in microseconds
+			file << "{\"traceEvents\":[\n";
+			file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+				 << "\"args\":{\"name\":\"parallel_sort\"}}";
+			for (std::size_t index = 0; index < this->threads(); index++)
+				file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << index
+					 << ",\"args\":{\"name\":\"worker " << index << "\"}}";
+
+			file << std::fixed << std::setprecision(3);
+			for (std::size_t index = 0; index < this->threads(); index++)
+			{
+				const trace_ring& ring = *rings[index];
+				for (std::size_t event = 0; event < ring.size(); event++)
+				{
+					const trace_event& e = ring[event];
+					file << ",\n{\"name\":\"" << e.name << "\",\"cat\":\""
+						 << internal::phase_names()[static_cast<std::size_t>(e.phase)]
+						 << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << index
+						 << ",\"ts\":" << e.begin / 1000.0 << ",\"dur\":" << (e.end - e.begin) / 1000.0
+						 << ",\"args\":{\"size\":" << e.size << ",\"depth\":" << e.depth << "}}";
+				}
+			}
+
+			file << "\n],\"displayTimeUnit\":\"ns\"}\n";
+			return file.good();
+		}
+
+	protected:
+		trace_ring* ring()
+		{
+			// Each thread claims a ring of its own once per tracer and caches it
+			struct binding { std::uint64_t tracer; trace_ring* ring; };
+			static thread_local binding cached = { 0, NULL };
+
+			if (cached.tracer != id)
+			{
+				std::size_t index = next.fetch_add(1, std::memory_order_relaxed);
+				cached.tracer = id;
+				cached.ring = (index < rings.size()) ? \
+					(rings[index] = std::unique_ptr<trace_ring>(new trace_ring(_capacity))).get() : NULL;
+			}
+
+			return cached.ring;
+		}
+
+		// The number of threads that have claimed a ring
+		std::size_t threads() const { return std::min(next.load(), rings.size()); }
+
+		std::uint64_t elapsed(std::chrono::steady_clock::time_point time) const {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(time - origin).count();
+		}
+
+		static std::atomic<std::uint64_t>& serial()
+		{
+			// The identifiers of the tracers start at 1, so that 0 means no binding
+			static std::atomic<std::uint64_t> counter(1);
+			return counter;
+		}
+
+	protected:
+		std::size_t _capacity;
+		std::vector<std::unique_ptr<trace_ring>> rings;
+		std::atomic<std::size_t> next, lost;
+		std::uint64_t id;
+		std::chrono::steady_clock::time_point origin;
+	};
+
+	class trace_scope
+	{
+	public:
+		trace_scope(sort_tracer* tracer, const char* name, sort_phase phase, std::size_t size, int depth)
+			: _tracer(tracer), _name(name), _phase(phase), _size(size), _depth(depth)
+		{
+			// Don't read the clock unless the caller has asked for the trace
+			if (_tracer != NULL) begin = std::chrono::steady_clock::now();
+		}
+
+		~trace_scope()
+		{
+			if (_tracer != NULL)
+				_tracer->record(_name, _phase, _size, _depth, begin, std::chrono::steady_clock::now());
+		}
+
+		trace_scope(const trace_scope&) = delete;
+		trace_scope& operator=(const trace_scope&) = delete;
+
+	protected:
+		sort_tracer* _tracer;
+		const char* _name; sort_phase _phase;
+		std::size_t _size; int _depth;
+		std::chrono::steady_clock::time_point begin;
+	};
+}
+
+#endif // TRACER_STL_H
@@ -0,0 +1,203 @@
+#ifndef TUNING_STL_H
+#define TUNING_STL_H
+
+namespace internal
+{
+	// The lower cutoff boundary
+	const std::size_t cutoff_low = 100;
+	// The higher cutoff boundary
+	const std::size_t cutoff_high = 1000;
+	// The cutoff boundary below which the array is sorted by a single thread
+	const std::size_t cutoff_parallel = 1000;
+
+	// The version of the tuning profile format
+	const int tuning_version = 1;
+
+	struct sort_tuning
+	{
+		// The size of the leaf subarrays sorted by the insertion sort
+		std::size_t leaf;
+		// The size of the partitions above which the parallel tasks are spawned
+		std::size_t spawn;
+		// The size of the array above which it's sorted by the team of threads
+		std::size_t parallel;
+	};
+
+	inline sort_tuning default_tuning()
+	{
+		// The compiled-in cutoff boundaries used unless a profile has been loaded
+		sort_tuning tuning = { internal::cutoff_low, internal::cutoff_high, internal::cutoff_parallel };
+		return tuning;
+	}
+
+	struct cache_info
+	{
+		// The sizes (in bytes) of the L1 data, L2 and the last level caches
+		std::size_t l1, l2, llc;
+	};
+
+	inline cache_info cache_sizes()
+	{
+		// Assume the typical cache sizes unless the actual ones can be obtained
+		cache_info caches = { 32768, 262144, 8388608 };
+
+	#if defined( _WIN32 )
+		DWORD length = 0;
+		::GetLogicalProcessorInformation(NULL, &length);
+		std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info( \
+			length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+
+		if (!info.empty() && ::GetLogicalProcessorInformation(info.data(), &length))
+		{
+			std::size_t llc_level = 0;
+			for (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION& item : info)
+			{
+				if (item.Relationship != RelationCache || item.Cache.Type == CacheInstruction)
+					continue;
+
+				if (item.Cache.Level == 1) caches.l1 = item.Cache.Size;
+				if (item.Cache.Level == 2) caches.l2 = item.Cache.Size;
+				if (item.Cache.Level >= llc_level) {
+					llc_level = item.Cache.Level; caches.llc = item.Cache.Size;
+				}
+			}
+		}
+	#else
+		// Read the caches of the first processor described in sysfs
+		std::size_t llc_level = 0;
+		for (int index = 0; index < 8; index++)
+		{
+			std::string path = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+			std::ifstream level_file(path + "level"), type_file(path + "type"), size_file(path + "size");
+
+			std::size_t level = 0, size = 0; std::string type, unit;
+			if (!(level_file >> level) || !(type_file >> type) || !(size_file >> size))
+				continue;
+
+			// The size is given in kilobytes (e.g. "32K") or megabytes (e.g. "8M")
+			size_file >> unit;
+			size *= (unit == "M") ? 1048576 : 1024;
+			if (type == "Instruction") continue;
+
+			if (level == 1) caches.l1 = size;
+			if (level == 2) caches.l2 = size;
+			if (level >= llc_level) {
+				llc_level = level; caches.llc = size;
+			}
+		}
+	#endif
+
+		return caches;
+	}
+
+	class tuning_profile
+	{
+	public:
+		tuning_profile() : caches(internal::cache_sizes()) { }
+
+	public:
+		bool load(const std::string& filename)
+		{
+			std::ifstream file(filename);
+			std::string header; int version = 0;
+			// Reject the files that don't carry the supported format version
+			if (!(file >> header >> version) || header != "parallel_sort_tuning" || \
+				version != internal::tuning_version)
+				return false;
+
+			// The cache sizes that the profile has been calibrated for
+			cache_info calibrated = { 0, 0, 0 };
+			if (!(file >> calibrated.l1 >> calibrated.l2 >> calibrated.llc))
+				return false;
+
+			// Reject the profile calibrated on the hardware with other caches (e.g. copied
+			// from another machine), since its cutoff boundaries don't hold here, so that
+			// the compiled-in defaults are used until the profile is calibrated again
+			if (calibrated.l1 != caches.l1 || calibrated.l2 != caches.l2 || calibrated.llc != caches.llc)
+			{
+				std::cerr << "parallel_sort: ignoring the tuning profile " << filename \
+					<< " calibrated for the caches " << calibrated.l1 << "/" << calibrated.l2 << "/" \
+					<< calibrated.llc << " rather than " << caches.l1 << "/" << caches.l2 << "/" \
+					<< caches.llc << " bytes, using the default cutoff boundaries\n";
+				return false;
+			}
+
+			std::vector<std::pair<std::size_t, sort_tuning>> loaded;
+			std::size_t element_size = 0; sort_tuning tuning;
+			while (file >> element_size >> tuning.leaf >> tuning.spawn >> tuning.parallel)
+				if (element_size > 0 && tuning.leaf > 1 && tuning.spawn > 1)
+					loaded.push_back(std::make_pair(element_size, tuning));
+
+			if (loaded.empty()) return false;
+			entries.swap(loaded);
+			return true;
+		}
+
+		bool save(const std::string& filename) const
+		{
+			std::ofstream file(filename);
+			if (!file.is_open()) return false;
+
+			file << "parallel_sort_tuning " << internal::tuning_version << "\n";
+			file << caches.l1 << " " << caches.l2 << " " << caches.llc << "\n";
+			for (const std::pair<std::size_t, sort_tuning>& entry : entries)
+				file << entry.first << " " << entry.second.leaf << " " \
+					 << entry.second.spawn << " " << entry.second.parallel << "\n";
+
+			return file.good();
+		}
+
+		void set(std::size_t element_size, const sort_tuning& tuning)
+		{
+			for (std::pair<std::size_t, sort_tuning>& entry : entries)
+				if (entry.first == element_size) {
+					entry.second = tuning; return;
+				}
+
+			entries.push_back(std::make_pair(element_size, tuning));
+		}
+
+		sort_tuning select(std::size_t element_size) const
+		{
+			// Use the entry calibrated for the nearest element size (by ratio),
+			// or the compiled-in defaults if the profile has no entries at all
+			sort_tuning tuning = internal::default_tuning();
+			double distance = std::numeric_limits<double>::max();
+			for (const std::pair<std::size_t, sort_tuning>& entry : entries)
+			{
+				double ratio = std::fabs(std::log((double)entry.first / element_size));
+				if (ratio < distance) {
+					distance = ratio; tuning = entry.second;
+				}
+			}
+
+			return tuning;
+		}
+
+		const cache_info& cache() const { return caches; }
+
+	public:
+		static const tuning_profile& active()
+		{
+			// Load the profile once, at startup by internal::initialize (psort::init), or
+			// otherwise when the first sort is performed. The file is named by the
+			// PARALLEL_SORT_TUNING environment variable, or otherwise it's the
+			// parallel_sort.tuning file in the current directory
+			static const tuning_profile profile = []()
+			{
+				tuning_profile loaded;
+				const char* filename = std::getenv("PARALLEL_SORT_TUNING");
+				loaded.load((filename != NULL) ? filename : "parallel_sort.tuning");
+				return loaded;
+			}();
+
+			return profile;
+		}
+
+	protected:
+		cache_info caches;
+		std::vector<std::pair<std::size_t, sort_tuning>> entries;
+	};
+}
+
+#endif // TUNING_STL_H
@@ -21,7 +21,8 @@ namespace misc
 		}
 
 		partitioner(const partitioner& p)
-			: _left(p.left_base()), _range(p.range_base()), partitions(p.count_base()) { }
+			: _left(p.left_base()), _range(p.range_base()), partitions(p.count_base()),
+			  length(p.size_base()), position(p.position_base()) { }
 
 	public:
 		const partitioner& operator[](std::size_t index) {
@@ -70,55 +71,34 @@ namespace misc
 		};
 	};
 
-	void init(std::vector<std::int64_t>& a, \
-			std::pair<std::size_t, std::size_t> range, std::size_t& count, int sort_type)
+	inline void init(gen::sequence& a, \
+			std::pair<std::size_t, std::size_t> range, std::size_t& count, int sort_type, \
+			std::uint64_t seed = gen::default_seed)
 	{
-		// Use STL Mersenne-Twister random values generator
-		std::random_device rd; std::mt19937 gen(rd());
-		std::uniform_int_distribution<> dist(range.first, range.second);
+		// Use the counter-based random values generator, so that
+		// the same seed always reproduces the same array
+		const gen::counter_rng rng(seed);
 
 		if (a.size() <= 0) {
 			if (count == 0)
-				count = dist(gen);
+				count = rng.uniform(0, range.first, range.second);
 
 			a.clear(); a.resize(count);
 		}
 
 		// Select the intial order of the array to be sorted
-		if (sort_type == 0)
-			gen::generate_random_sequence(a, count);
-		else if (sort_type == 1)
-			gen::generate_lots_of_duplicates(a, count);
-		else if (sort_type == 2)
-			gen::generate_binary_sequence(a, count);
-		else if (sort_type == 3)
-			gen::generate_ascending_sequence(a, count);
-		else if (sort_type == 4)
-			gen::generate_descending_sequence(a, count);
-		else if (sort_type == 5)
-			gen::generate_interleave_sequence(a, count);
-		else if (sort_type == 6)
-			gen::generate_single_value(a, count);
-
+		// from the catalog of the available distributions
+		const std::vector<gen::distribution>& catalog = gen::distributions();
+		if (sort_type >= 0 && sort_type < static_cast<int>(catalog.size()))
+			catalog[sort_type].generate(a, count, seed);
 	}
 
-	std::string sorttype2string(int sort_type)
+	inline std::string sorttype2string(int sort_type)
 	{
 		std::string s_type = "";
-		if (sort_type == 0)
-			s_type = "randomized sequence";
-		else if (sort_type == 1)
-			s_type = "lots of duplicates";
-		else if (sort_type == 2)
-			s_type = "binary sequence";
-		else if (sort_type == 3)
-			s_type ="ascending sequence";
-		else if (sort_type == 4)
-			s_type = "descending sequence";
-		else if (sort_type == 5)
-			s_type = "interleave sequence";
-		else if (sort_type == 6)
-			s_type = "single value sequence";
+		const std::vector<gen::distribution>& catalog = gen::distributions();
+		if (sort_type >= 0 && sort_type < static_cast<int>(catalog.size()))
+			s_type = catalog[sort_type].title;
 
 		return s_type;
 	}
@@ -132,7 +112,7 @@ namespace misc
 		// Iterate through the array and perform a check if its sorted
 		for (auto _FwdIt = _First; _FwdIt != _Last - 1 && is_sorted; _FwdIt++)
 		{
-			if (!compare(*_FwdIt, *(_FwdIt + 1)) && *_FwdIt != *(_FwdIt + 1))
+			if (compare(*(_FwdIt + 1), *_FwdIt))
 			{
 				if (is_sorted == true)
 					position = std::distance(_First, _FwdIt);
@@ -0,0 +1,668 @@
+#include "psort.h"
+
+#ifndef BENCHMARK_STL_H
+#define BENCHMARK_STL_H
+
+namespace bench
+{
+	// The version of the baseline file format
+	const int baseline_version = 3;
+	// The relative slowdown tolerated before a difference counts as a regression
+	const double tolerance = 0.05;
+
+	struct record128
+	{
+		// The key of the record followed by the payload that makes it 128 bytes long
+		std::int64_t key; char payload[120];
+	};
+
+	inline bool operator<(const record128& first, const record128& second) {
+		return first.key < second.key;
+	}
+
+	inline const std::vector<std::string>& elements()
+	{
+		// The element types of the arrays being sorted: the plain integers, the strings
+		// that own heap memory and the large records that are expensive to copy
+		static const std::vector<std::string> names = { "int64", "string", "record128" };
+		return names;
+	}
+
+	inline const std::vector<std::string>& engines()
+	{
+		// The quicksort backends being compared, in the order of psort::sort_engine
+		static const std::vector<std::string> names = { "three_way", "dual_pivot" };
+		return names;
+	}
+
+	inline int find_engine(const std::string& name)
+	{
+		const std::vector<std::string>& names = bench::engines();
+		std::size_t index = std::find(names.begin(), names.end(), name) - names.begin();
+		return (index < names.size()) ? static_cast<int>(index) : -1;
+	}
+
+	struct sample
+	{
+		// The name of the distribution of the input array
+		std::string distribution;
+		// The name of the element type of the input array
+		std::string element;
+		// The name of the quicksort backend
+		std::string engine;
+		// The number of data items and the number of threads
+		std::size_t size; int threads;
+		// The number of trials and the statistics of their execution walltime (ms)
+		std::size_t trials; double mean; double stddev;
+	};
+
+	inline double student_t(double df)
+	{
+		// The two-sided 95% quantiles of Student's t-distribution for 1..30 degrees of freedom
+		static const double quantiles[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365,
+			2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093,
+			2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+
+		std::size_t index = (df < 1.0) ? 0 : static_cast<std::size_t>(df) - 1;
+		return (index < 30) ? quantiles[index] : 1.960;
+	}
+
+	inline double confidence(const sample& s)
+	{
+		// Compute the half-width of the 95% confidence interval of the mean
+		return (s.trials > 1) ? student_t(s.trials - 1.0) * \
+			s.stddev / std::sqrt((double)s.trials) : 0.0;
+	}
+
+	inline bool regressed(const sample& base, const sample& current)
+	{
+		// Ignore differences that are below the tolerated slowdown
+		if (current.mean <= base.mean * (1.0 + bench::tolerance))
+			return false;
+
+		// Perform Welch's t-test of the difference between the means
+		double vb = base.stddev * base.stddev / base.trials;
+		double vc = current.stddev * current.stddev / current.trials;
+		if (vb + vc <= 0.0) return true;
+
+		double df = (vb + vc) * (vb + vc) / ((base.trials > 1 ? vb * vb / (base.trials - 1) : 0.0) + \
+			(current.trials > 1 ? vc * vc / (current.trials - 1) : 0.0));
+		return (current.mean - base.mean) / std::sqrt(vb + vc) > student_t(df);
+	}
+
+	template<class T, class _Make, class _Pred>
+	bool run(const gen::sequence& keys, _Make make, _Pred compare, \
+		psort::sort_engine engine, std::size_t trials, std::vector<double>& times, \
+		psort::perf_recorder* perf = NULL)
+	{
+		// Build the input array of the given element type from the generated keys
+		std::vector<T> array, array_copy; bool is_sorted = true;
+		array.reserve(keys.size());
+		for (std::int64_t key : keys) array.push_back(make(key));
+
+		// Run one warm-up trial followed by the measured trials
+		for (std::size_t trial = 0; trial <= trials && is_sorted; trial++)
+		{
+			array_copy = array;
+
+			std::chrono::steady_clock::time_point \
+				time_s = std::chrono::steady_clock::now();
+
+			// Count the hardware events of the measured trials only (if requested)
+			psort::sort_stats stats;
+			internal::parallel_sort(array_copy.begin(), array_copy.end(), compare, stats, \
+				internal::thread_pool::shared(), NULL, NULL, engine, NULL, (trial > 0) ? perf : NULL);
+
+			std::chrono::steady_clock::time_point \
+				time_f = std::chrono::steady_clock::now();
+
+			std::size_t position = 0L;
+			is_sorted = misc::sorted(array_copy.begin(), \
+				array_copy.end(), position, compare) != 0;
+
+			if (trial > 0)
+				times.push_back(std::chrono::duration<double, \
+					std::milli>(time_f - time_s).count());
+		}
+
+		return is_sorted;
+	}
+
+	inline bool measure(sample& s, psort::perf_recorder* perf = NULL, \
+		std::uint64_t seed = gen::default_seed)
+	{
+		int sort_type = gen::find_distribution(s.distribution);
+		int engine_type = bench::find_engine(s.engine);
+		if (sort_type < 0 || engine_type < 0) return false;
+
+		psort::sort_engine engine = static_cast<psort::sort_engine>(engine_type);
+
+		gen::sequence keys;
+		std::vector<double> times; bool is_sorted = false;
+		std::size_t count = s.size; int max_threads = omp_get_max_threads();
+
+		omp_set_num_threads(s.threads);
+		// Generate the keys once and sort the arrays of the selected element type
+		misc::init(keys, std::make_pair(count, count), count, sort_type, seed);
+		if (s.element == "int64")
+			is_sorted = bench::run<std::int64_t>(keys, [](std::int64_t key) { return key; },
+				[](std::int64_t first, std::int64_t end) { return first < end; }, engine, s.trials, times, perf);
+		else if (s.element == "string")
+			is_sorted = bench::run<std::string>(keys, [](std::int64_t key) { return std::to_string(key); },
+				[](const std::string& first, const std::string& end) { return first < end; }, engine, s.trials, times, perf);
+		else if (s.element == "record128")
+			is_sorted = bench::run<record128>(keys, [](std::int64_t key) {
+					record128 r; r.key = key; std::fill_n(r.payload, sizeof(r.payload), char(key)); return r; },
+				[](const record128& first, const record128& end) { return first.key < end.key; }, engine, s.trials, times, perf);
+
+		omp_set_num_threads(max_threads);
+
+		// Compute the mean and the sample standard deviation of the trials
+		double sum = 0.0, sq_sum = 0.0;
+		for (double t : times) sum += t;
+		s.mean = times.empty() ? 0.0 : sum / times.size();
+		for (double t : times) sq_sum += (t - s.mean) * (t - s.mean);
+		s.stddev = (times.size() > 1) ? std::sqrt(sq_sum / (times.size() - 1)) : 0.0;
+
+		return is_sorted;
+	}
+
+	inline std::vector<sample> matrix(std::vector<int> sort_types, std::size_t trials)
+	{
+		// Use all distributions of the catalog unless a subset has been selected by name
+		if (sort_types.empty())
+			for (std::size_t index = 0; index < gen::distributions().size(); index++)
+				sort_types.push_back(static_cast<int>(index));
+
+		std::vector<int> threads = { 1 };
+		if (omp_get_num_procs() > 1)
+			threads.push_back(omp_get_num_procs());
+
+		const std::size_t sizes[] = { 100000, 1000000, 10000000 };
+
+		std::vector<sample> samples;
+		for (const std::string& element : bench::elements())
+			for (const std::string& engine : bench::engines())
+				for (int sort_type : sort_types)
+					for (std::size_t size : sizes)
+					{
+						// Keep the arrays of strings and records within a reasonable amount of memory
+						if (element != "int64" && size > 1000000) continue;
+
+						for (int count : threads)
+							samples.push_back(sample{ gen::distributions()[sort_type].name, \
+								element, engine, size, count, trials, 0.0, 0.0 });
+					}
+
+		return samples;
+	}
+
+	inline bool save(const std::string& filename, const std::vector<sample>& samples)
+	{
+		std::ofstream file(filename);
+		if (!file.is_open()) return false;
+
+		file << "parallel_sort_baseline " << bench::baseline_version << "\n";
+		file << std::setprecision(6) << std::fixed;
+		for (const sample& s : samples)
+			file << s.distribution << " " << s.element << " " << s.engine << " " << s.size << " " << s.threads << " "
+				 << s.trials << " " << s.mean << " " << s.stddev << "\n";
+
+		return file.good();
+	}
+
+	inline bool load(const std::string& filename, std::vector<sample>& samples)
+	{
+		std::ifstream file(filename);
+		std::string header; int version = 0;
+		// Reject the files that don't carry the supported format version
+		if (!(file >> header >> version) || header != "parallel_sort_baseline" || \
+			version != bench::baseline_version)
+			return false;
+
+		sample s;
+		while (file >> s.distribution >> s.element >> s.engine >> s.size >> s.threads >> s.trials >> s.mean >> s.stddev)
+			samples.push_back(s);
+
+		return !samples.empty();
+	}
+
+	inline void print(const sample& s)
+	{
+		std::cout << std::setiosflags(std::ios::fixed) << std::setprecision(4)
+			<< std::setw(24) << std::left << s.distribution << " " << std::setw(9) << s.element
+			<< " " << std::setw(10) << s.engine << std::right
+			<< " size = " << std::setw(9) << s.size << " threads = " << std::setw(3) << s.threads
+			<< " time: " << s.mean << " ms (+/- " << bench::confidence(s) << " ms)";
+	}
+
+	inline void print(const psort::perf_recorder& perf, std::size_t trials)
+	{
+		const std::vector<std::string>& events = internal::perf_event_names();
+		const std::vector<std::string>& phases = internal::phase_names();
+
+		bool is_available = false;
+		for (std::size_t event = 0; event < events.size(); event++)
+			is_available = is_available || perf.available(event);
+
+		if (is_available == false) {
+			std::cout << "    hardware counters: unavailable\n"; return;
+		}
+
+		// Print the events of each phase per sort, summed up over all workers
+		for (std::size_t phase = 0; phase < phases.size(); phase++)
+		{
+			internal::sort_phase p = static_cast<internal::sort_phase>(phase);
+			if (perf.count(p) == 0) continue;
+
+			std::cout << "    " << std::setw(9) << std::left << phases[phase] << std::right;
+			for (std::size_t event = 0; event < events.size(); event++)
+			{
+				std::cout << " " << events[event] << " = ";
+				if (perf.available(event))
+					std::cout << perf.value(p, event) / std::max(std::size_t(1), trials);
+				else std::cout << "n/a";
+			}
+
+			std::cout << "\n";
+		}
+	}
+
+	inline int record(const std::string& filename, const std::vector<int>& sort_types, \
+		std::size_t trials = 10, bool counters = false)
+	{
+		std::vector<sample> samples = bench::matrix(sort_types, trials);
+		for (sample& s : samples)
+		{
+			// Measure each configuration of the matrix and terminate if the sorting has failed
+			psort::perf_recorder perf;
+			bool is_sorted = bench::measure(s, counters ? &perf : NULL);
+			bench::print(s); std::cout << "\n";
+			if (counters) bench::print(perf, s.trials);
+			if (!is_sorted) {
+				std::cout << "verification: failed\n"; return 2;
+			}
+		}
+
+		if (!bench::save(filename, samples)) {
+			std::cout << "unable to write the baseline file: " << filename << "\n"; return 2;
+		}
+
+		std::cout << "baseline recorded: " << filename << "\n";
+		return 0;
+	}
+
+	inline int compare(const std::string& filename, bool counters = false)
+	{
+		std::vector<sample> baseline;
+		if (!bench::load(filename, baseline)) {
+			std::cout << "unable to read the baseline file: " << filename << "\n"; return 2;
+		}
+
+		std::size_t regressions = 0L;
+		for (const sample& base : baseline)
+		{
+			// Re-run the same configuration and compare it with the baseline
+			sample current = base; psort::perf_recorder perf;
+			bool is_sorted = bench::measure(current, counters ? &perf : NULL);
+			bench::print(current);
+
+			if (!is_sorted) {
+				std::cout << " verification: failed\n"; return 2;
+			}
+
+			double ratio = (base.mean > 0.0) ? current.mean / base.mean : 1.0;
+			std::cout << std::setprecision(2) << " (baseline: " << base.mean << " ms, ratio: "
+				<< (ratio - 1.0) * 100 << "%)";
+
+			if (bench::regressed(base, current)) {
+				std::cout << " REGRESSION"; regressions++;
+			}
+
+			std::cout << "\n";
+			if (counters) bench::print(perf, current.trials);
+		}
+
+		std::cout << regressions << " regression(s) out of " << baseline.size() << " configurations\n";
+		return (regressions > 0) ? 1 : 0;
+	}
+
+	inline int trace(const std::string& filename, const std::vector<int>& sort_types, \
+		std::size_t count = 10000000)
+	{
+		// Sort an array of the first selected distribution with the tracer attached
+		int sort_type = sort_types.empty() ? gen::find_distribution("random") : sort_types.front();
+		gen::sequence array;
+		misc::init(array, std::make_pair(count, count), count, sort_type);
+
+		psort::sort_tracer tracer; psort::sort_stats stats;
+		std::chrono::steady_clock::time_point \
+			time_s = std::chrono::steady_clock::now();
+
+		internal::parallel_sort(array.begin(), array.end(), std::less<std::int64_t>(), stats, \
+			internal::thread_pool::shared(), NULL, NULL, internal::sort_engine::three_way, NULL, NULL, &tracer);
+
+		std::chrono::steady_clock::time_point \
+			time_f = std::chrono::steady_clock::now();
+
+		std::size_t position = 0L;
+		if (!misc::sorted(array.begin(), array.end(), position, std::less<std::int64_t>())) {
+			std::cout << "verification: failed\n"; return 2;
+		}
+
+		std::cout << std::setiosflags(std::ios::fixed) << std::setprecision(4)
+			<< gen::distributions()[sort_type].name << " size = " << count << " threads = " << stats.threads
+			<< " time: " << std::chrono::duration<double, std::milli>(time_f - time_s).count() << " ms tasks = "
+			<< stats.tasks << " events dropped = " << tracer.dropped() << "\n";
+
+		if (!tracer.save(filename)) {
+			std::cout << "unable to write the trace file: " << filename << "\n"; return 2;
+		}
+
+		std::cout << "trace written: " << filename << "\n";
+		return 0;
+	}
+
+	inline int pages(const std::vector<int>& sort_types, std::size_t trials = 3, \
+		std::size_t count = 100000000)
+	{
+		// Sort the same array backed by the small pages and by the huge pages in turn,
+		// drawing the scratch buffers from the same pages, and compare the TLB misses
+		int sort_type = sort_types.empty() ? gen::find_distribution("random") : sort_types.front();
+		gen::sequence keys;
+		misc::init(keys, std::make_pair(count, count), count, sort_type);
+
+		internal::huge_page_mode modes[] = { internal::huge_page_mode::none, \
+			(internal::huge_page_config() == internal::huge_page_mode::hugetlbfs) ? \
+				internal::huge_page_mode::hugetlbfs : internal::huge_page_mode::transparent };
+		const char* names[] = { "none", "transparent", "hugetlbfs" };
+
+		for (internal::huge_page_mode mode : modes)
+		{
+			internal::huge_page_resource resource(mode);
+			psort::perf_recorder perf; std::vector<double> times;
+			bool is_sorted = true;
+
+			for (std::size_t trial = 0; trial <= trials && is_sorted; trial++)
+			{
+				std::vector<std::int64_t, internal::arena_allocator<std::int64_t>> \
+					array(keys.begin(), keys.end(), internal::arena_allocator<std::int64_t>(&resource));
+
+				std::chrono::steady_clock::time_point \
+					time_s = std::chrono::steady_clock::now();
+
+				// Count the hardware events of the measured trials only
+				psort::sort_stats stats;
+				internal::parallel_sort(array.begin(), array.end(), std::less<std::int64_t>(), stats, \
+					internal::thread_pool::shared(), NULL, &resource, internal::sort_engine::three_way, \
+					NULL, (trial > 0) ? &perf : NULL);
+
+				std::chrono::steady_clock::time_point \
+					time_f = std::chrono::steady_clock::now();
+
+				std::size_t position = 0L;
+				is_sorted = misc::sorted(array.begin(), array.end(), position, std::less<std::int64_t>()) != 0;
+				if (trial > 0)
+					times.push_back(std::chrono::duration<double, std::milli>(time_f - time_s).count());
+			}
+
+			if (!is_sorted) {
+				std::cout << "verification: failed\n"; return 2;
+			}
+
+			std::sort(times.begin(), times.end());
+			std::cout << std::setiosflags(std::ios::fixed) << std::setprecision(2)
+				<< gen::distributions()[sort_type].name << " size = " << count << " pages = "
+				<< names[static_cast<int>(mode)] << " (" << resource.huge_allocations() << " huge, "
+				<< resource.small_allocations() << " small blocks) median: "
+				<< (times.empty() ? 0.0 : times[times.size() / 2]) << " ms\n";
+			bench::print(perf, trials);
+		}
+
+		return 0;
+	}
+
+	inline void print(const internal::record_summary& summary, bool verify = true)
+	{
+		// Print the summary in the terms of valsort
+		std::cout << "records = " << summary.records << " checksum = " << std::hex << std::setfill('0')
+			<< std::setw(16) << summary.checksum_high << std::setw(16) << summary.checksum_low
+			<< std::dec << std::setfill(' ') << " duplicate keys = " << summary.duplicates << "\n";
+		if (verify == false) return;
+		if (summary.is_sorted())
+			std::cout << "verification: all records are in order\n";
+		else std::cout << "verification: failed, " << summary.unordered << " unordered records, the first at "
+			<< summary.first_unordered << "\n";
+	}
+
+	inline double throughput(std::size_t records, double ms)
+	{
+		// The throughput in the megabytes (10^6 bytes) of records per second
+		return (ms > 0.0) ? records * internal::record_size / (ms * 1000.0) : 0.0;
+	}
+
+	inline int records(std::size_t count = 10000000, std::size_t trials = 3)
+	{
+		// Sort the generated records in memory from the input array into the output one,
+		// and report the median throughput of the trials following the warm-up one
+		internal::record_array input(count), output(count);
+		internal::generate_records(input.begin(), input.end());
+		internal::record_summary expected = internal::validate_records(input.begin(), input.end());
+
+		std::vector<double> times; psort::sort_stats stats;
+		for (std::size_t trial = 0; trial <= trials; trial++)
+		{
+			std::chrono::steady_clock::time_point \
+				time_s = std::chrono::steady_clock::now();
+
+			internal::sort_records(input.begin(), input.end(), output.begin(), stats);
+
+			std::chrono::steady_clock::time_point \
+				time_f = std::chrono::steady_clock::now();
+
+			if (trial > 0)
+				times.push_back(std::chrono::duration<double, std::milli>(time_f - time_s).count());
+		}
+
+		std::sort(times.begin(), times.end());
+		double median = times.empty() ? 0.0 : times[times.size() / 2];
+		std::cout << std::setiosflags(std::ios::fixed) << std::setprecision(2)
+			<< "gensort records = " << count << " threads = " << stats.threads << " median: "
+			<< median << " ms (" << bench::throughput(count, median) << " MB/s)\n";
+
+		// The sorted records must be a permutation of the input, hence the same checksum
+		internal::record_summary summary = internal::validate_records(output.begin(), output.end());
+		bench::print(summary);
+		return (summary.is_sorted() && summary.checksum_high == expected.checksum_high && \
+			summary.checksum_low == expected.checksum_low) ? 0 : 2;
+	}
+
+	inline int gensort(const std::string& filename, std::size_t count)
+	{
+		// Write the file of the generated records
+		internal::record_array records(count);
+		internal::generate_records(records.begin(), records.end());
+		if (!internal::write_records(filename, records)) {
+			std::cout << "unable to write the records file: " << filename << "\n"; return 2;
+		}
+
+		std::cout << "records written: " << filename << "\n";
+		bench::print(internal::validate_records(records.begin(), records.end()), false);
+		return 0;
+	}
+
+	inline int valsort(const std::string& filename)
+	{
+		internal::record_array records;
+		if (!internal::read_records(filename, records)) {
+			std::cout << "unable to read the records file: " << filename << "\n"; return 2;
+		}
+
+		internal::record_summary summary = internal::validate_records(records.begin(), records.end());
+		bench::print(summary);
+		return summary.is_sorted() ? 0 : 2;
+	}
+
+	inline int sort_file(const std::string& input, const std::string& output)
+	{
+		// Sort the file of records into the output file, reporting the throughput
+		// of the sort alone and of the whole path including the file transfers
+		std::chrono::steady_clock::time_point \
+			time_s = std::chrono::steady_clock::now();
+
+		internal::record_array records, sorted;
+		if (!internal::read_records(input, records)) {
+			std::cout << "unable to read the records file: " << input << "\n"; return 2;
+		}
+
+		std::chrono::steady_clock::time_point \
+			time_r = std::chrono::steady_clock::now();
+
+		psort::sort_stats stats;
+		sorted.resize(records.size());
+		internal::sort_records(records.begin(), records.end(), sorted.begin(), stats);
+
+		std::chrono::steady_clock::time_point \
+			time_w = std::chrono::steady_clock::now();
+
+		if (!internal::write_records(output, sorted)) {
+			std::cout << "unable to write the records file: " << output << "\n"; return 2;
+		}
+
+		std::chrono::steady_clock::time_point \
+			time_f = std::chrono::steady_clock::now();
+
+		double sort_ms = std::chrono::duration<double, std::milli>(time_w - time_r).count();
+		double total_ms = std::chrono::duration<double, std::milli>(time_f - time_s).count();
+		std::cout << std::setiosflags(std::ios::fixed) << std::setprecision(2)
+			<< "gensort records = " << sorted.size() << " threads = " << stats.threads
+			<< " sort: " << sort_ms << " ms (" << bench::throughput(sorted.size(), sort_ms) << " MB/s)"
+			<< " total: " << total_ms << " ms (" << bench::throughput(sorted.size(), total_ms) << " MB/s)\n";
+
+		internal::record_summary summary = internal::validate_records(sorted.begin(), sorted.end());
+		bench::print(summary);
+		return summary.is_sorted() ? 0 : 2;
+	}
+
+	template<class T>
+	double calibrate(const std::vector<T>& array, const internal::sort_tuning& tuning, \
+		int threads, std::size_t trials)
+	{
+		std::vector<T> array_copy; std::vector<double> times;
+		int max_threads = omp_get_max_threads();
+
+		// Sort the array with the given cutoff boundaries and obtain the median walltime
+		omp_set_num_threads(threads);
+		for (std::size_t trial = 0; trial < trials; trial++)
+		{
+			array_copy = array;
+
+			std::chrono::steady_clock::time_point \
+				time_s = std::chrono::steady_clock::now();
+
+			psort::sort_stats stats;
+			internal::parallel_sort(array_copy.begin(), array_copy.end(), std::less<T>(), stats, \
+				internal::thread_pool::shared(), NULL, NULL, internal::sort_engine::three_way, &tuning);
+
+			std::chrono::steady_clock::time_point \
+				time_f = std::chrono::steady_clock::now();
+
+			times.push_back(std::chrono::duration<double, std::milli>(time_f - time_s).count());
+		}
+
+		omp_set_num_threads(max_threads);
+
+		std::sort(times.begin(), times.end());
+		return times[times.size() / 2];
+	}
+
+	template<class T, class _Make>
+	internal::sort_tuning calibrate(_Make make, const internal::cache_info& caches, std::size_t trials)
+	{
+		// Generate the random array of about 8 MiB of data items of the given type
+		gen::sequence keys; std::vector<T> array;
+		std::size_t count = std::max(std::size_t(65536), std::size_t(8388608) / sizeof(T));
+		misc::init(keys, std::make_pair(count, count), count, gen::find_distribution("random"));
+		for (std::int64_t key : keys) array.push_back(make(key));
+
+		int threads = omp_get_max_threads();
+		internal::sort_tuning best = internal::default_tuning(); best.parallel = 0;
+
+		// Perform the sweep of each cutoff boundary in turn, keeping the best value found
+		// so far for the others: the leaf size first, then the task spawn threshold
+		const std::size_t leaves[] = { 8, 16, 32, 64, 128, 256 };
+		double best_time = std::numeric_limits<double>::max();
+		for (std::size_t leaf : leaves)
+		{
+			internal::sort_tuning tuning = best; tuning.leaf = leaf;
+			double time = bench::calibrate(array, tuning, threads, trials);
+			if (time < best_time) {
+				best_time = time; best.leaf = leaf;
+			}
+		}
+
+		// The candidate spawn thresholds include the number of items that fit in L2
+		const std::size_t spawns[] = { 1024, 4096, 16384, 65536, \
+			std::max(std::size_t(1024), caches.l2 / sizeof(T)) };
+		best_time = std::numeric_limits<double>::max();
+		for (std::size_t spawn : spawns)
+		{
+			internal::sort_tuning tuning = best; tuning.spawn = spawn;
+			double time = bench::calibrate(array, tuning, threads, trials);
+			if (time < best_time) {
+				best_time = time; best.spawn = spawn;
+			}
+		}
+
+		// Find the smallest array size at which the team of threads outperforms a single thread
+		best.parallel = internal::cutoff_parallel;
+		if (threads > 1)
+		{
+			best.parallel = count;
+			for (std::size_t size = 1024; size < count; size *= 4)
+			{
+				std::vector<T> part(array.begin(), array.begin() + size);
+				internal::sort_tuning tuning = best; tuning.parallel = 0;
+				if (bench::calibrate(part, tuning, threads, trials) < \
+					bench::calibrate(part, tuning, 1, trials)) {
+					best.parallel = size; break;
+				}
+			}
+		}
+
+		return best;
+	}
+
+	inline int tune(const std::string& filename, std::size_t trials = 3)
+	{
+		internal::tuning_profile profile;
+		const internal::cache_info& caches = profile.cache();
+		std::cout << "caches: L1 = " << caches.l1 / 1024 << " KiB, L2 = " << caches.l2 / 1024
+			<< " KiB, LLC = " << caches.llc / 1024 << " KiB, threads = " << omp_get_max_threads() << "\n";
+
+		// Calibrate the cutoff boundaries for each element type of the benchmark matrix
+		profile.set(sizeof(std::int64_t), bench::calibrate<std::int64_t>( \
+			[](std::int64_t key) { return key; }, caches, trials));
+		profile.set(sizeof(std::string), bench::calibrate<std::string>( \
+			[](std::int64_t key) { return std::to_string(key); }, caches, trials));
+		profile.set(sizeof(record128), bench::calibrate<record128>([](std::int64_t key) {
+			record128 r; r.key = key; std::fill_n(r.payload, sizeof(r.payload), char(key)); return r; }, caches, trials));
+
+		const std::size_t sizes[] = { sizeof(std::int64_t), sizeof(std::string), sizeof(record128) };
+		for (std::size_t size : sizes)
+		{
+			internal::sort_tuning tuning = profile.select(size);
+			std::cout << "element size = " << std::setw(4) << size << " leaf = " << tuning.leaf
+				<< " spawn = " << tuning.spawn << " parallel = " << tuning.parallel << "\n";
+		}
+
+		if (!profile.save(filename)) {
+			std::cout << "unable to write the tuning profile: " << filename << "\n"; return 2;
+		}
+
+		std::cout << "tuning profile written: " << filename << "\n";
+		return 0;
+	}
+}
+
+#endif // BENCHMARK_STL_H
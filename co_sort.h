@@ -0,0 +1,231 @@
+#include "parallel_sort.h"
+
+#ifndef CO_SORT_STL_H
+#define CO_SORT_STL_H
+
+namespace internal
+{
+	// The number of rows gathered per block, so that the block of the permutation stays in L1
+	const std::size_t gather_rows = 2048;
+	// The number of rows the source of the gather is prefetched ahead
+	const std::size_t prefetch_distance = 16;
+
+	inline void prefetch(const void* address)
+	{
+		// Hint the processor to load the cache line that will be read shortly
+	#if defined( _WIN32 )
+		_mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+	#else
+		__builtin_prefetch(address);
+	#endif
+	}
+
+	inline bool carry_payload(std::size_t size, std::size_t key_bytes, \
+		std::size_t payload_bytes, std::size_t index_bytes)
+	{
+		// Estimate the bytes moved by either approach. The sort moves each row about
+		// log2(n) times and both approaches copy the rows in and out of the sorted array.
+		// Carrying the payload makes the rows larger, while the permutation makes
+		// them carry an index and then reads, writes and moves back each payload row
+		double passes = std::max(1.0, std::log2((double)size)) + 2.0;
+		double carried = passes * (key_bytes + payload_bytes);
+		double permuted = passes * (key_bytes + index_bytes) + index_bytes + 3.0 * payload_bytes;
+		return carried <= permuted;
+	}
+
+	template<class Column>
+	struct column_traits
+	{
+		typedef typename std::decay<decltype(*std::begin(std::declval<Column&>()))>::type value_type;
+	};
+
+	template<class RanIt, class _Pred, class Index>
+	void sort_permutation(RanIt _First, RanIt _Last, _Pred compare, std::vector<Index>& perm, \
+		sort_stats& stats, thread_pool& pool = thread_pool::shared())
+	{
+		typedef typename std::iterator_traits<RanIt>::value_type T;
+		typedef std::pair<T, Index> row;
+
+		// Carry the original position of each key alongside it through the sort
+		std::int64_t _Size = std::distance(_First, _Last);
+		std::vector<row> rows(_Size);
+		{
+			// Release the workers before the sort draws them from the same pool
+			pool_lease lease(pool, omp_get_max_threads());
+			#pragma omp parallel for num_threads(lease.size()) schedule(static)
+			for (std::int64_t index = 0; index < _Size; index++)
+				rows[index] = row(std::move(_First[index]), static_cast<Index>(index));
+		}
+
+		internal::parallel_sort(rows.begin(), rows.end(), [compare](const row& first, const row& second) {
+			return compare(first.first, second.first); }, stats, pool);
+
+		// Put the sorted keys back and keep the positions as the permutation
+		perm.resize(_Size);
+		pool_lease lease(pool, omp_get_max_threads());
+		#pragma omp parallel for num_threads(lease.size()) schedule(static)
+		for (std::int64_t index = 0; index < _Size; index++) {
+			_First[index] = std::move(rows[index].first); perm[index] = rows[index].second;
+		}
+	}
+
+	template<class Index, class SrcIt, class DestIt>
+	void gather(const Index* perm, std::size_t first, std::size_t last, SrcIt _Src, DestIt _Dest)
+	{
+		// Gather the rows [first, last) of the column, prefetching the source rows ahead,
+		// since these are read in the random order given by the permutation
+		for (std::size_t row = first; row < last; row++)
+		{
+			if (row + internal::prefetch_distance < last)
+				internal::prefetch(&*(_Src + perm[row + internal::prefetch_distance]));
+			*(_Dest + row) = std::move(*(_Src + perm[row]));
+		}
+	}
+
+	template<class T, class Column>
+	void store(std::vector<T>& buffer, Column& column, int threads)
+	{
+		// Move the gathered rows back into the column
+		std::int64_t _Size = buffer.size();
+		#pragma omp parallel for num_threads(threads) schedule(static)
+		for (std::int64_t index = 0; index < _Size; index++)
+			*(std::begin(column) + index) = std::move(buffer[index]);
+	}
+
+	template<class T>
+	void store(std::vector<T>& buffer, std::vector<T>& column, int threads)
+	{
+		// Exchange the gathered buffer with the column rather than moving the rows
+		if (buffer.size() == column.size()) column.swap(buffer);
+		else internal::store<T, std::vector<T>>(buffer, column, threads);
+	}
+
+	template<class Index, class Sources, class Buffers, std::size_t... I>
+	void gather_block(const Index* perm, std::size_t first, std::size_t last, \
+		Sources& sources, Buffers& buffers, std::index_sequence<I...>)
+	{
+		// Gather the same block of rows from each column while the block
+		// of the permutation is still in the cache
+		using expand = int[];
+		(void)expand { 0, (internal::gather(perm, first, last, \
+			std::begin(std::get<I>(sources)), std::get<I>(buffers).begin()), 0)... };
+	}
+
+	template<class Sources, class Buffers, std::size_t... I>
+	void store_columns(Sources& sources, Buffers& buffers, int threads, std::index_sequence<I...>)
+	{
+		using expand = int[];
+		(void)expand { 0, (internal::store(std::get<I>(buffers), std::get<I>(sources), threads), 0)... };
+	}
+
+	template<class Index, class... Columns>
+	void apply_permutation(const std::vector<Index>& perm, thread_pool& pool, Columns&... columns)
+	{
+		pool_lease lease(pool, omp_get_max_threads());
+
+		// Gather each column into a buffer of its own, block by block in parallel
+		std::tuple<Columns&...> sources(columns...);
+		std::tuple<std::vector<typename column_traits<Columns>::value_type>...> \
+			buffers(std::vector<typename column_traits<Columns>::value_type>(perm.size())...);
+
+		std::int64_t blocks = (perm.size() + internal::gather_rows - 1) / internal::gather_rows;
+		#pragma omp parallel for num_threads(lease.size()) schedule(static)
+		for (std::int64_t block = 0; block < blocks; block++)
+		{
+			std::size_t first = block * internal::gather_rows;
+			std::size_t last = std::min(perm.size(), first + internal::gather_rows);
+			internal::gather_block(perm.data(), first, last, sources, buffers, \
+				std::index_sequence_for<Columns...>());
+		}
+
+		internal::store_columns(sources, buffers, lease.size(), std::index_sequence_for<Columns...>());
+	}
+
+	template<class Sources, class Rows, std::size_t... I>
+	void load_rows(Sources& sources, Rows& rows, std::int64_t index, std::index_sequence<I...>)
+	{
+		// Copy the payload of the row from each column next to the key
+		using expand = int[];
+		(void)expand { 0, (std::get<I + 1>(rows[index]) = std::move(*(std::begin(std::get<I>(sources)) + index)), 0)... };
+	}
+
+	template<class Sources, class Rows, std::size_t... I>
+	void store_rows(Sources& sources, Rows& rows, std::int64_t index, std::index_sequence<I...>)
+	{
+		// Move the payload of the sorted row back to each column
+		using expand = int[];
+		(void)expand { 0, (*(std::begin(std::get<I>(sources)) + index) = std::move(std::get<I + 1>(rows[index])), 0)... };
+	}
+
+	template<class RanIt, class _Pred, class... Columns>
+	void carry_sort(RanIt _First, RanIt _Last, _Pred compare, \
+		sort_stats& stats, thread_pool& pool, Columns&... columns)
+	{
+		typedef typename std::iterator_traits<RanIt>::value_type T;
+		typedef std::tuple<T, typename column_traits<Columns>::value_type...> row;
+
+		// Sort the keys along with the payloads of all columns inside the engine
+		std::int64_t _Size = std::distance(_First, _Last);
+		std::tuple<Columns&...> sources(columns...);
+		std::vector<row> rows(_Size);
+		{
+			// Release the workers before the sort draws them from the same pool
+			pool_lease lease(pool, omp_get_max_threads());
+			#pragma omp parallel for num_threads(lease.size()) schedule(static)
+			for (std::int64_t index = 0; index < _Size; index++) {
+				std::get<0>(rows[index]) = std::move(_First[index]);
+				internal::load_rows(sources, rows, index, std::index_sequence_for<Columns...>());
+			}
+		}
+
+		internal::parallel_sort(rows.begin(), rows.end(), [compare](const row& first, const row& second) {
+			return compare(std::get<0>(first), std::get<0>(second)); }, stats, pool);
+
+		pool_lease lease(pool, omp_get_max_threads());
+		#pragma omp parallel for num_threads(lease.size()) schedule(static)
+		for (std::int64_t index = 0; index < _Size; index++) {
+			_First[index] = std::move(std::get<0>(rows[index]));
+			internal::store_rows(sources, rows, index, std::index_sequence_for<Columns...>());
+		}
+	}
+
+	template<class Index, class RanIt, class _Pred, class... Columns>
+	void permute_sort(RanIt _First, RanIt _Last, _Pred compare, \
+		sort_stats& stats, thread_pool& pool, Columns&... columns)
+	{
+		// Sort the keys along with their positions and gather the columns afterwards
+		std::vector<Index> perm;
+		internal::sort_permutation(_First, _Last, compare, perm, stats, pool);
+		internal::apply_permutation(perm, pool, columns...);
+	}
+
+	template<class RanIt, class _Pred, class... Columns>
+	void co_sort(RanIt _First, RanIt _Last, _Pred compare, \
+		sort_stats& stats, thread_pool& pool, Columns&... columns)
+	{
+		typedef typename std::iterator_traits<RanIt>::value_type T;
+
+		std::size_t _Size = std::distance(_First, _Last);
+		if (_Size < 2) return;
+
+		// The total size of the payload of a row over all columns
+		std::size_t payload_bytes = 0L;
+		using expand = std::size_t[];
+		for (std::size_t bytes : expand { 0, sizeof(typename column_traits<Columns>::value_type)... })
+			payload_bytes += bytes;
+
+		// Use the narrow positions unless the array is too large to be indexed by them
+		bool is_narrow = _Size <= std::numeric_limits<std::uint32_t>::max();
+		std::size_t index_bytes = is_narrow ? sizeof(std::uint32_t) : sizeof(std::size_t);
+
+		// Pick the approach that moves fewer bytes: carrying the small payloads
+		// alongside the keys, or sorting the positions and gathering the columns
+		if (internal::carry_payload(_Size, sizeof(T), payload_bytes, index_bytes))
+			internal::carry_sort(_First, _Last, compare, stats, pool, columns...);
+		else if (is_narrow)
+			internal::permute_sort<std::uint32_t>(_First, _Last, compare, stats, pool, columns...);
+		else internal::permute_sort<std::size_t>(_First, _Last, compare, stats, pool, columns...);
+	}
+}
+
+#endif // CO_SORT_STL_H
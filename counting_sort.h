@@ -0,0 +1,116 @@
+#include "arena.h"
+#include "profiler.h"
+
+#ifndef COUNTING_SORT_STL_H
+#define COUNTING_SORT_STL_H
+
+namespace internal
+{
+	// The largest range of keys counted by the per-thread histograms, so that
+	// each histogram stays within the cache of its worker
+	const std::uint64_t counting_range = 65536;
+	// The minimum number of data items per key of the range worth counting
+	const std::uint64_t counting_density = 8;
+
+	inline bool counting_domain(std::uint64_t range, std::size_t size)
+	{
+		// Perform a check if the range of keys is small relative to the array size
+		return range < internal::counting_range && \
+			(range + 1) * internal::counting_density <= size;
+	}
+
+	template<class RanIt, class _Pred>
+	bool parallel_sorted(RanIt _First, RanIt _Last, _Pred compare, int threads)
+	{
+		// Check that no data item is less than its predecessor, by all threads at once
+		std::int64_t _Size = std::distance(_First, _Last);
+		std::int64_t inversions = 0;
+		#pragma omp parallel for num_threads(threads) schedule(static) reduction(+:inversions)
+		for (std::int64_t index = 1; index < _Size; index++)
+			if (compare(_First[index], _First[index - 1])) inversions++;
+
+		return inversions == 0;
+	}
+
+	template<class RanIt, class _Pred>
+	bool counting_sort(RanIt _First, RanIt _Last, _Pred compare, int threads, \
+		const input_profile& profile, memory_resource* scratch, std::true_type)
+	{
+		typedef typename std::iterator_traits<RanIt>::value_type T;
+
+		// Restore the bounds of keys found by the profiler
+		std::int64_t _Size = profile.size;
+		std::uint64_t range = profile.range;
+		T lo = static_cast<T>(profile.lo), hi = static_cast<T>(profile.lo + range);
+
+		// Lay the keys out in the order of the comparator, which is either ascending
+		// or descending for the integral keys, unless it orders them otherwise
+		bool is_ascending = compare(lo, hi);
+		if (!is_ascending && !compare(hi, lo)) return false;
+
+		// Count the keys of each chunk in the histogram of its thread. The histograms
+		// and the offsets are drawn from the scratch memory rather than from the heap
+		arena_allocator<std::size_t> allocator(scratch);
+		std::vector<std::size_t, arena_allocator<std::size_t>> histograms(threads * (range + 1), 0, allocator);
+		std::vector<std::size_t, arena_allocator<std::size_t>> offsets(range + 2, 0, allocator);
+		#pragma omp parallel num_threads(threads) shared(histograms, offsets)
+		{
+			int tid = omp_get_thread_num(), team = omp_get_num_threads();
+			std::size_t* counts = histograms.data() + tid * (range + 1);
+
+			#pragma omp for schedule(static)
+			for (std::int64_t index = 0; index < _Size; index++)
+				counts[is_ascending ? static_cast<std::uint64_t>(_First[index]) - static_cast<std::uint64_t>(lo) : \
+					static_cast<std::uint64_t>(hi) - static_cast<std::uint64_t>(_First[index])]++;
+
+			// Sum up the histograms of all threads for each key
+			#pragma omp for schedule(static)
+			for (std::int64_t key = 0; key <= static_cast<std::int64_t>(range); key++)
+				for (int thread = 0; thread < team; thread++)
+					offsets[key + 1] += histograms[thread * (range + 1) + key];
+
+			#pragma omp single
+			for (std::uint64_t key = 0; key <= range; key++)
+				offsets[key + 1] += offsets[key];
+
+			// Fill the equal shares of the array, each beginning with the key
+			// whose run covers the first position of the share
+			std::size_t begin = _Size * tid / team, end = _Size * (tid + 1) / team;
+			std::uint64_t key = std::upper_bound(offsets.begin(), offsets.end(), begin) - offsets.begin() - 1;
+			for (std::size_t index = begin; index < end; key++)
+			{
+				T value = static_cast<T>(is_ascending ? static_cast<std::uint64_t>(lo) + key : \
+					static_cast<std::uint64_t>(hi) - key);
+				std::size_t last = std::min(end, offsets[key + 1]);
+				std::fill(_First + index, _First + last, value);
+				index = last;
+			}
+		}
+
+		// Verify the result, since the comparator might not order the keys by their values
+		return internal::parallel_sorted(_First, _Last, compare, threads);
+	}
+
+	template<class RanIt, class _Pred>
+	bool counting_sort(RanIt, RanIt, _Pred, int, const input_profile&, memory_resource*, std::false_type)
+	{
+		// The data items of other types are never sorted by counting
+		return false;
+	}
+
+	template<class RanIt, class _Pred>
+	bool counting_sort(RanIt _First, RanIt _Last, _Pred compare, int threads, \
+		const input_profile& profile, memory_resource* scratch = internal::default_resource())
+	{
+		// Sort the integral keys of a small range by counting them; returns false and
+		// leaves the array to the comparison sort if the keys don't qualify
+		typedef typename std::iterator_traits<RanIt>::value_type T;
+		if (!profile.is_integral || !internal::counting_domain(profile.range, profile.size))
+			return false;
+
+		return internal::counting_sort(_First, _Last, compare, std::max(1, threads), profile, scratch, \
+			std::integral_constant<bool, std::is_integral<T>::value && !std::is_same<T, bool>::value>());
+	}
+}
+
+#endif // COUNTING_SORT_STL_H
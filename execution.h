@@ -0,0 +1,158 @@
+#include "stable_sort.h"
+
+#ifndef EXECUTION_STL_H
+#define EXECUTION_STL_H
+
+namespace internal
+{
+	enum class policy_kind
+	{
+		// Sort by the calling thread only
+		sequenced,
+		// Sort by the team of threads drawn from the pool
+		parallel,
+		// Sort by the team of threads, the vectorized passes being allowed
+		parallel_unsequenced,
+		// Sort by the team of threads, keeping the order of the equal items
+		stable
+	};
+
+	template<policy_kind Kind>
+	struct execution_policy
+	{
+		// The number of threads requested for the sort (0 means the whole share
+		// of the pool) and the pool the threads are drawn from (NULL means the shared one)
+		int threads; thread_pool* pool;
+
+		execution_policy operator()(int count) const
+		{
+			// The same policy limited to the given number of threads
+			execution_policy policy = { std::max(1, count), pool };
+			return policy;
+		}
+
+		execution_policy on(thread_pool& workers) const
+		{
+			// The same policy drawing its threads from the given pool
+			execution_policy policy = { threads, &workers };
+			return policy;
+		}
+	};
+
+	template<class Policy>
+	struct is_execution_policy : std::false_type { };
+
+	template<policy_kind Kind>
+	struct is_execution_policy<execution_policy<Kind>> : std::true_type { };
+
+	struct identity
+	{
+		// The projection that yields the data item itself
+		template<class T>
+		T&& operator()(T&& value) const { return std::forward<T>(value); }
+	};
+
+	template<class Proj, class T>
+	auto project(const Proj& proj, T& value, std::false_type) -> decltype(proj(value))
+	{
+		return proj(value);
+	}
+
+	template<class Proj, class T>
+	auto project(const Proj& proj, T& value, std::true_type) -> decltype(value.*proj)
+	{
+		// Project the data item to its member selected by the pointer
+		return value.*proj;
+	}
+
+	template<class _Pred, class Proj>
+	struct projected_compare
+	{
+		// Compare the data items by the keys the projection yields for them; the projection
+		// is either a callable or a pointer to the data member holding the key
+		template<class T1, class T2>
+		bool operator()(T1&& first, T2&& second) const
+		{
+			typedef std::is_member_object_pointer<Proj> is_member;
+			return compare(internal::project(proj, first, is_member()), \
+				internal::project(proj, second, is_member()));
+		}
+
+		_Pred compare; Proj proj;
+	};
+
+	struct thread_limit
+	{
+	public:
+		// Limit the number of threads the calling thread requests for its teams,
+		// and so from the pool, restoring the previous limit when out of scope
+		explicit thread_limit(int count) : saved(omp_get_max_threads()) {
+			omp_set_num_threads(std::max(1, count));
+		}
+
+		~thread_limit() { omp_set_num_threads(saved); }
+
+		thread_limit(const thread_limit&) = delete;
+		thread_limit& operator=(const thread_limit&) = delete;
+
+	protected:
+		int saved;
+	};
+
+	template<class RanIt, class _Pred>
+	void policy_sort(RanIt _First, RanIt _Last, _Pred compare, thread_pool& pool, \
+		sort_stats& stats, std::integral_constant<policy_kind, policy_kind::sequenced>)
+	{
+		// Raise the parallel cutoff boundary above the array size,
+		// so that the sort never leases more than a single thread
+		sort_tuning cutoffs = internal::tuning_for(_First);
+		cutoffs.parallel = std::numeric_limits<std::size_t>::max();
+		internal::parallel_sort(_First, _Last, compare, stats, pool, \
+			NULL, NULL, sort_engine::three_way, &cutoffs);
+	}
+
+	template<class RanIt, class _Pred>
+	void policy_sort(RanIt _First, RanIt _Last, _Pred compare, thread_pool& pool, \
+		sort_stats& stats, std::integral_constant<policy_kind, policy_kind::parallel>)
+	{
+		internal::parallel_sort(_First, _Last, compare, stats, pool);
+	}
+
+	template<class RanIt, class _Pred>
+	void policy_sort(RanIt _First, RanIt _Last, _Pred compare, thread_pool& pool, \
+		sort_stats& stats, std::integral_constant<policy_kind, policy_kind::parallel_unsequenced>)
+	{
+		// The partitioning is driven by the comparator and has no vectorized
+		// counterpart, so the vectorized passes are those the compiler emits
+		// for the profiling, counting and reversing loops of the parallel sort
+		internal::parallel_sort(_First, _Last, compare, stats, pool);
+	}
+
+	template<class RanIt, class _Pred>
+	void policy_sort(RanIt _First, RanIt _Last, _Pred compare, thread_pool& pool, \
+		sort_stats& stats, std::integral_constant<policy_kind, policy_kind::stable>)
+	{
+		internal::parallel_stable_sort(_First, _Last, compare, stats, pool);
+	}
+
+	template<policy_kind Kind, class RanIt, class _Pred>
+	void policy_sort(const execution_policy<Kind>& policy, \
+		RanIt _First, RanIt _Last, _Pred compare, sort_stats& stats)
+	{
+		typedef std::integral_constant<policy_kind, Kind> kind;
+		thread_pool& pool = (policy.pool != NULL) ? *policy.pool : thread_pool::shared();
+
+		if (policy.threads <= 0 || Kind == policy_kind::sequenced)
+		{
+			internal::policy_sort(_First, _Last, compare, pool, stats, kind());
+			return;
+		}
+
+		// Request no more than the given number of threads, so that the lease
+		// the sort takes from the bounded pool is the team of the sort
+		thread_limit limit(policy.threads);
+		internal::policy_sort(_First, _Last, compare, pool, stats, kind());
+	}
+}
+
+#endif // EXECUTION_STL_H
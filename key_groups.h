@@ -0,0 +1,175 @@
+#ifndef KEY_GROUPS_STL_H
+#define KEY_GROUPS_STL_H
+
+namespace internal
+{
+	// The (offset, length) of a run of the items with equal keys in the sorted array
+	typedef std::pair<std::size_t, std::size_t> key_group;
+
+	// The number of items of the uncovered ranges scanned by a single task
+	const std::size_t group_scan_grain = 65536;
+
+	template<class RanIt>
+	const void* iterator_tag()
+	{
+		// The address unique to the iterator type, so that the recorded
+		// positions are never measured from the base of another type
+		static const char tag = 0;
+		return &tag;
+	}
+
+	class key_groups
+	{
+	public:
+		key_groups() : base(NULL), tag(NULL) { }
+
+		key_groups(const key_groups&) = delete;
+		key_groups& operator=(const key_groups&) = delete;
+
+	public:
+		template<class RanIt>
+		void bind(const RanIt& _First, int threads)
+		{
+			// Measure the positions of the groups from the first item of the array
+			// and give each worker a list of its own to record the groups into
+			base = &_First; tag = internal::iterator_tag<RanIt>();
+			recorded.assign(std::max(1, threads), std::vector<key_group>());
+			groups.clear();
+		}
+
+		template<class RanIt>
+		void record(RanIt _First, RanIt _Last)
+		{
+			// Record the run [_First, _Last] of the items equal to a pivot, that might be a whole
+			// group of equal keys. The run is checked once the sort has completed, since the
+			// partitions of some schemes don't keep all the items with equal keys together;
+			// the groups within the leaves are left to the scan of the uncovered ranges
+			if (tag != internal::iterator_tag<RanIt>()) return;
+
+			std::size_t offset = std::distance(*static_cast<const RanIt*>(base), _First);
+			recorded[omp_get_thread_num() % recorded.size()].push_back( \
+				key_group(offset, std::distance(_First, _Last) + 1));
+		}
+
+		template<class RanIt, class _Pred>
+		void complete(RanIt _First, RanIt _Last, _Pred compare, int threads)
+		{
+			std::size_t _Size = std::distance(_First, _Last);
+			threads = std::max(1, threads);
+
+			// Order the runs recorded by each worker, then merge the lists pairwise,
+			// so that all runs end up in the order of their positions
+			std::int64_t lists = recorded.size();
+			#pragma omp parallel for num_threads(threads) schedule(dynamic)
+			for (std::int64_t list = 0; list < lists; list++)
+				std::sort(recorded[list].begin(), recorded[list].end());
+
+			while (recorded.size() > 1)
+			{
+				std::int64_t pairs = recorded.size() / 2;
+				std::vector<std::vector<key_group>> merged((recorded.size() + 1) / 2);
+				#pragma omp parallel for num_threads(threads) schedule(dynamic)
+				for (std::int64_t pair = 0; pair < pairs; pair++)
+				{
+					const std::vector<key_group>& first = recorded[2 * pair], & second = recorded[2 * pair + 1];
+					merged[pair].resize(first.size() + second.size());
+					std::merge(first.begin(), first.end(), second.begin(), second.end(), merged[pair].begin());
+				}
+
+				if (recorded.size() % 2 != 0)
+					merged.back() = std::move(recorded.back());
+				recorded.swap(merged);
+			}
+
+			std::vector<key_group> runs;
+			if (!recorded.empty()) runs.swap(recorded.front());
+			recorded.clear();
+			runs.erase(std::unique(runs.begin(), runs.end()), runs.end());
+
+			// Keep the runs that are still the whole groups of the sorted array: the items
+			// at both ends are equal and differ from their neighbours outside of the run
+			std::vector<key_group> exact;
+			for (const key_group& run : runs)
+			{
+				std::size_t first = run.first, last = run.first + run.second - 1;
+				if (last >= _Size || (!exact.empty() && exact.back().first + exact.back().second > first))
+					continue;
+
+				if (!compare(_First[first], _First[last]) && \
+					(first == 0 || compare(_First[first - 1], _First[first])) && \
+					(last + 1 == _Size || compare(_First[last], _First[last + 1])))
+					exact.push_back(run);
+			}
+
+			// Split the ranges not covered by the exact runs into the pieces scanned
+			// in parallel for the boundaries of the groups, and note the number
+			// of the exact runs lying ahead of each piece
+			std::vector<key_group> pieces;
+			std::vector<std::size_t> ahead;
+			std::size_t covered = 0L;
+			for (std::size_t index = 0; index <= exact.size(); index++)
+			{
+				std::size_t end = (index < exact.size()) ? exact[index].first : _Size;
+				for (std::size_t first = covered; first < end; first += internal::group_scan_grain) {
+					pieces.push_back(key_group(first, std::min(end - first, internal::group_scan_grain)));
+					ahead.push_back(index);
+				}
+
+				if (index < exact.size())
+					covered = exact[index].first + exact[index].second;
+			}
+
+			// Find the first item of each group within the pieces. The first item of
+			// an uncovered range always begins a group, since the exact run ahead of
+			// it differs from it
+			std::vector<std::vector<std::size_t>> starts(pieces.size());
+			std::int64_t count = pieces.size();
+			#pragma omp parallel for num_threads(threads) schedule(dynamic)
+			for (std::int64_t piece = 0; piece < count; piece++)
+			{
+				std::size_t first = pieces[piece].first, last = first + pieces[piece].second;
+				for (std::size_t index = first; index < last; index++)
+					if (index == 0 || compare(_First[index - 1], _First[index]))
+						starts[piece].push_back(index);
+			}
+
+			// Place each piece in the list of the groups after the exact runs ahead of it
+			// and the groups of the earlier pieces, then fill the list in parallel
+			std::vector<std::size_t> offsets(pieces.size() + 1, 0L);
+			for (std::size_t piece = 0; piece < pieces.size(); piece++)
+				offsets[piece + 1] = offsets[piece] + starts[piece].size();
+
+			groups.resize(offsets.back() + exact.size());
+			#pragma omp parallel for num_threads(threads) schedule(dynamic)
+			for (std::int64_t piece = 0; piece <= count; piece++)
+			{
+				std::size_t run = (piece > 0) ? ahead[piece - 1] : 0L;
+				std::size_t end = (piece < count) ? ahead[piece] : exact.size();
+				std::size_t position = offsets[piece] + run;
+				for (; run < end; run++)
+					groups[position++].first = exact[run].first;
+				if (piece < count)
+					for (std::size_t head : starts[piece])
+						groups[position++].first = head;
+			}
+
+			std::int64_t total = groups.size();
+			#pragma omp parallel for num_threads(threads) schedule(static)
+			for (std::int64_t index = 0; index < total; index++)
+				groups[index].second = ((index + 1 < total) ? groups[index + 1].first : _Size) - groups[index].first;
+
+			base = NULL; tag = NULL;
+		}
+
+	public:
+		// The groups of equal keys of the sorted array in the order of their positions
+		std::vector<key_group> groups;
+
+	protected:
+		const void* base;
+		const void* tag;
+		std::vector<std::vector<key_group>> recorded;
+	};
+}
+
+#endif // KEY_GROUPS_STL_H
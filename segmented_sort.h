@@ -0,0 +1,147 @@
+#include "parallel_sort.h"
+
+#ifndef SEGMENTED_SORT_STL_H
+#define SEGMENTED_SORT_STL_H
+
+namespace internal
+{
+	template<class RanIt, class _Pred>
+	void sequential_sort(RanIt _First, RanIt _Last, _Pred compare, sort_context& ctx)
+	{
+		// Sort the array [_First, _Last) within the current thread
+		std::size_t _Size = std::distance(_First, _Last);
+		if (_Size < 2) return;
+
+		if (_Size <= ctx.tuning.leaf)
+			internal::leaf_sort(_First, _Last, compare, ctx);
+		else
+		{
+			// Perform the quicksort without spawning the parallel tasks
+			sort_context local = { 1, sort_stats(), ctx.control, ctx.scratch, ctx.engine, ctx.tuning, 0L, 0L, ctx.perf, ctx.tracer, NULL };
+			internal::quick_sort(_First, _Last - 1, compare, local);
+
+			#pragma omp atomic
+			ctx.stats.depth += local.stats.depth;
+		}
+	}
+
+	template<class Segments, class _Pred>
+	void segmented_sort(Segments& segments, _Pred compare, sort_context& ctx)
+	{
+		typedef typename Segments::value_type::first_type RanIt;
+
+		std::size_t total = 0L;
+		for (const std::pair<RanIt, RanIt>& s : segments)
+			total += std::distance(s.first, s.second);
+
+		// The segments larger than the fair share of a thread are split across threads,
+		// the smaller ones are grouped into batches sorted one batch per task
+		const std::size_t large = std::max(ctx.tuning.spawn, total / ctx.threads);
+		const std::size_t grain = std::max(ctx.tuning.spawn, total / (ctx.threads * 8));
+
+		// The quicksort of the large segments spawns the tasks of the same granularity
+		ctx.grain = std::max(ctx.grain, internal::task_grain(total, ctx.threads));
+
+		// Schedule all segments as the tasks of a single parallel region
+		#pragma omp parallel num_threads(ctx.threads) shared(segments, ctx)
+		#pragma omp single nowait
+		{
+			std::size_t batch_first = 0L, batch_size = 0L;
+			for (std::size_t index = 0; index < segments.size(); index++)
+			{
+				RanIt _First = segments[index].first, _Last = segments[index].second;
+				std::size_t _Size = std::distance(_First, _Last);
+
+				if (_Size > large)
+				{
+					// Launch the quicksort that spawns the tasks of its own
+					#pragma omp task untied mergeable shared(ctx)
+					{
+						internal::trace_scope trace(ctx.tracer, "segment", sort_phase::partition, _Size, 0);
+						internal::quick_sort(_First, _Last - 1, compare, ctx);
+					}
+					continue;
+				}
+
+				// Append the tiny or medium segment to the current batch and
+				// launch a task once the batch has accumulated enough data items
+				batch_size += _Size;
+				if (batch_size >= grain || index + 1 == segments.size())
+				{
+					std::size_t first = batch_first, last = index + 1, items = batch_size;
+					#pragma omp task untied mergeable shared(segments, ctx)
+					{
+						internal::trace_scope trace(ctx.tracer, "batch", sort_phase::leaf, items, 0);
+						for (std::size_t batch = first; batch < last; batch++)
+							if (static_cast<std::size_t>(std::distance(segments[batch].first, \
+								segments[batch].second)) <= large)
+								internal::sequential_sort(segments[batch].first, \
+									segments[batch].second, compare, ctx);
+					}
+
+					batch_first = index + 1; batch_size = 0L;
+				}
+			}
+
+			// Launch the last batch if it has been interrupted by a large segment
+			if (batch_first < segments.size())
+			{
+				std::size_t first = batch_first, last = segments.size(), items = batch_size;
+				#pragma omp task untied mergeable shared(segments, ctx)
+				{
+					internal::trace_scope trace(ctx.tracer, "batch", sort_phase::leaf, items, 0);
+					for (std::size_t batch = first; batch < last; batch++)
+						if (static_cast<std::size_t>(std::distance(segments[batch].first, \
+							segments[batch].second)) <= large)
+							internal::sequential_sort(segments[batch].first, \
+								segments[batch].second, compare, ctx);
+				}
+			}
+		}
+	}
+
+	template<class RanIt, class OffsetIt, class _Pred>
+	void segmented_sort(RanIt _First, OffsetIt _OffFirst, OffsetIt _OffLast, _Pred compare, \
+		sort_stats& stats, thread_pool& pool = thread_pool::shared(), memory_resource* scratch = NULL)
+	{
+		pool_lease lease(pool, omp_get_max_threads());
+		sort_context ctx = { lease.size(), sort_stats(), NULL, scratch, \
+			sort_engine::three_way, internal::tuning_for(_First), 0L, 0L, NULL, NULL, NULL };
+
+		// Build the list of segments [_First + offset[i], _First + offset[i + 1])
+		// within the scratch memory, which can be reused by the subsequent calls
+		std::vector<std::pair<RanIt, RanIt>, arena_allocator<std::pair<RanIt, RanIt>>> \
+			segments(arena_allocator<std::pair<RanIt, RanIt>>(internal::scratch(ctx)));
+		segments.reserve(std::max(std::ptrdiff_t(1), std::distance(_OffFirst, _OffLast)));
+		for (OffsetIt _OffIt = _OffFirst; _OffIt != _OffLast && std::next(_OffIt) != _OffLast; _OffIt++)
+			segments.push_back(std::make_pair(_First + *_OffIt, _First + *std::next(_OffIt)));
+
+		internal::segmented_sort(segments, compare, ctx);
+
+		stats = ctx.stats; stats.threads = ctx.threads;
+	}
+
+	template<class Ranges, class _Pred>
+	void segmented_sort(Ranges& ranges, _Pred compare, sort_stats& stats, \
+		thread_pool& pool = thread_pool::shared(), memory_resource* scratch = NULL)
+	{
+		typedef decltype(std::begin(*std::begin(ranges))) RanIt;
+
+		pool_lease lease(pool, omp_get_max_threads());
+		sort_context ctx = { lease.size(), sort_stats(), NULL, scratch, \
+			sort_engine::three_way, internal::tuning_for(RanIt()), 0L, 0L, NULL, NULL, NULL };
+
+		// Build the list of segments from the range of ranges within the scratch memory
+		std::vector<std::pair<RanIt, RanIt>, arena_allocator<std::pair<RanIt, RanIt>>> \
+			segments(arena_allocator<std::pair<RanIt, RanIt>>(internal::scratch(ctx)));
+		segments.reserve(std::max(std::ptrdiff_t(1), std::distance(std::begin(ranges), std::end(ranges))));
+		for (auto& range : ranges)
+			segments.push_back(std::make_pair(std::begin(range), std::end(range)));
+
+		internal::segmented_sort(segments, compare, ctx);
+
+		stats = ctx.stats; stats.threads = ctx.threads;
+	}
+}
+
+#endif // SEGMENTED_SORT_STL_H